@@ -0,0 +1,66 @@
+//Checks that in-band headers (see `TINYLEAKCHECK_INBAND_HEADER`) catch double frees and pointers
+//	that `operator new` never returned.  The tracer is compiled right into this example, since it
+//	has to be built with the headers, and with an assertion that notes failures instead of aborting
+//	(so that the program can go on to check the next case).  Returns the number of cases missed.
+
+#include <cstdio>
+#include <cstring>
+
+static char const* caught = nullptr;
+static void note_caught( char const* message ) noexcept
+{
+	if ( caught == nullptr ) caught=message;
+}
+
+#define TINYLEAKCHECK_WHEN_ENABLED 0b11
+#define TINYLEAKCHECK_INBAND_HEADER
+#define TINYLEAKCHECK_ASSERT( CHECK_EXPR, FMT_CSTR, ... ) ( (CHECK_EXPR) ? (void)0 : note_caught(FMT_CSTR) )
+#include <tinyleakcheck/tinyleakcheck.cpp>
+
+
+
+static int missed = 0;
+static void expect( char const* what, char const* expected )
+{
+	if ( caught!=nullptr && strncmp( caught, expected, strlen(expected) )==0 )
+	{
+		printf( "Caught %s: \"%s\"\n", what, caught );
+	}
+	else
+	{
+		printf( "Missed %s!\n", what );
+		++missed;
+	}
+	caught = nullptr;
+}
+
+int main( int /*argc*/, char* /*argv*/[] )
+{
+	TinyLeakCheck::prevent_linker_elison();
+
+	//(`volatile`, so that the compiler can't see what we're up to and "helpfully" elide it.)
+
+	int* volatile freed = new int(1);
+	delete freed;
+	caught = nullptr;
+	delete freed;
+	expect( "double free", "Double free" );
+
+	char* block = new char[64]();
+	char* volatile inside = block + 32;
+	caught = nullptr;
+	operator delete( inside );
+	expect( "bad pointer", "Deleting an invalid pointer" );
+	delete[] block;
+
+	int* volatile fine = new int(2);
+	caught = nullptr;
+	delete fine;
+	if ( caught != nullptr )
+	{
+		printf( "False alarm on a good pointer: \"%s\"\n", caught );
+		++missed;
+	}
+
+	return missed;
+}
@@ -5,20 +5,41 @@
 
 #include "tinyleakcheck.hpp"
 
+#if defined TINYLEAKCHECK_ENABLED && defined TINYLEAKCHECK_CUSTOM_BACKEND
+	extern TinyLeakCheck::Backend const TINYLEAKCHECK_CUSTOM_BACKEND;
+#endif
+
 #ifdef _WIN32
 	#include <Windows.h>
 	#include <DbgHelp.h>
 	#undef IGNORE
 	#pragma comment(lib, "dbghelp.lib")
 #else
-	#include <cstring>
+	#include <cxxabi.h>
+	#include <dlfcn.h>
 	#include <execinfo.h>
+	#include <fcntl.h>
+	#include <pthread.h>
+	#include <sys/mman.h>
+	#include <unistd.h>
+	#include <unwind.h>
+#endif
+#if defined _MSC_VER && !defined __clang__
+	#include <intrin.h>
 #endif
 
+#include <algorithm>
 #include <bit>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
 #include <format>
-#include <mutex>
+#include <new>
+#include <optional>
+#include <stacktrace>
 #include <sstream>
+#include <unordered_map>
 #include <vector>
 
 #if defined __GNUC__ && !defined __clang__
@@ -52,11 +73,196 @@ TypeTo bit_cast( TypeFrom const& from ) noexcept
 
 
 
+#if defined _MSC_VER && !defined __clang__
+	#define TINYLEAKCHECK_NOINLINE __declspec(noinline)
+	#define TINYLEAKCHECK_RETURN_ADDRESS() _ReturnAddress()
+#else
+	#define TINYLEAKCHECK_NOINLINE [[gnu::noinline]]
+	#define TINYLEAKCHECK_RETURN_ADDRESS() __builtin_return_address(0)
+#endif
+
+
+
 namespace TinyLeakCheck
 {
 
 
 
+/*
+The C library's allocation functions, for the tracer's own use.  Normally these are just
+`malloc(⋯)` and friends, but when this is built to be preloaded (`TINYLEAKCHECK_PRELOAD`), it *is*
+`malloc(⋯)` and friends (see the bottom of this file), and the tracer mustn't recurse into its own
+versions.  So the next definitions along, the C library's, are looked up with `dlsym(RTLD_NEXT,⋯)`
+on first use.
+
+That lookup can itself allocate (e.g. `dlsym(⋯)` `calloc(⋯)`s its error buffer), as can other
+threads while it's in progress.  Such requests are served from a static bootstrap arena instead:
+a bump allocator that never reuses anything, so its blocks are already zeroed.  Freeing them does
+nothing, and reallocating one copies it out.
+*/
+#ifdef TINYLEAKCHECK_PRELOAD
+
+#ifdef _WIN32
+	#error "`TINYLEAKCHECK_PRELOAD` is not supported on Windows!"
+#endif
+#ifndef TINYLEAKCHECK_ENABLED
+	#error "`TINYLEAKCHECK_PRELOAD` requires TinyLeakCheck to be enabled (see `TINYLEAKCHECK_WHEN_ENABLED`)!"
+#endif
+
+struct _LibcFunctions final
+{
+	void* (*malloc        )( std::size_t                                    );
+	void* (*calloc        )( std::size_t count, std::size_t size            );
+	void* (*realloc       )( void* ptr, std::size_t size                    );
+	void  (*free          )( void* ptr                                      );
+	int   (*posix_memalign)( void** result, std::size_t alignment, std::size_t size );
+	void* (*aligned_alloc )( std::size_t alignment, std::size_t size        );
+	void* (*memalign      )( std::size_t alignment, std::size_t size        );
+};
+static _LibcFunctions _libc;
+static std::atomic<int> _libc_state = 0; //0 unresolved, 1 being resolved, 2 resolved
+
+static constexpr std::size_t _bootstrap_size = std::size_t(1) << 20;
+alignas(64) static unsigned char _bootstrap_arena[ _bootstrap_size ];
+static std::atomic<std::size_t> _bootstrap_used = 0;
+
+[[nodiscard]] inline static bool _is_bootstrap( void const* ptr ) noexcept
+{
+	auto begin = std::bit_cast<uintptr_t>( static_cast<void const*>(_bootstrap_arena) );
+	auto addr  = std::bit_cast<uintptr_t>(ptr);
+	return addr>=begin && addr<begin+_bootstrap_size;
+}
+//Each block is preceded by its size, for `realloc(⋯)`.  The alignment must be a power of two.
+[[nodiscard]] static void* _bootstrap_alloc( std::size_t alignment, std::size_t size ) noexcept
+{
+	alignment = std::max( alignment, std::size_t(__STDCPP_DEFAULT_NEW_ALIGNMENT__) );
+	auto begin = std::bit_cast<uintptr_t>( static_cast<void*>(_bootstrap_arena) );
+
+	std::size_t used = _bootstrap_used.load(std::memory_order_relaxed);
+	std::size_t offset;
+	do
+	{
+		uintptr_t addr = ( begin + used + sizeof(std::size_t) + alignment-1 ) & ~uintptr_t(alignment-1);
+		offset = addr - begin;
+		if ( offset>_bootstrap_size || size>_bootstrap_size-offset ) [[unlikely]] return nullptr;
+	}
+	while ( !_bootstrap_used.compare_exchange_weak( used, offset+size, std::memory_order_relaxed ) );
+
+	memcpy( _bootstrap_arena+offset-sizeof(std::size_t), &size, sizeof(std::size_t) );
+	return _bootstrap_arena + offset;
+}
+
+//Whether the C library's functions can be called.  If not, use the bootstrap arena.
+[[nodiscard]] static bool _libc_resolve() noexcept
+{
+	int state = 0;
+	if ( !_libc_state.compare_exchange_strong( state, 1, std::memory_order_acquire ) )
+	{
+		return state == 2; //Otherwise, being resolved (possibly by this very thread, recursively)
+	}
+
+	_libc.malloc         = reinterpret_cast<decltype(_libc.malloc        )>( dlsym( RTLD_NEXT, "malloc"         ) );
+	_libc.calloc         = reinterpret_cast<decltype(_libc.calloc        )>( dlsym( RTLD_NEXT, "calloc"         ) );
+	_libc.realloc        = reinterpret_cast<decltype(_libc.realloc       )>( dlsym( RTLD_NEXT, "realloc"        ) );
+	_libc.free           = reinterpret_cast<decltype(_libc.free          )>( dlsym( RTLD_NEXT, "free"           ) );
+	_libc.posix_memalign = reinterpret_cast<decltype(_libc.posix_memalign)>( dlsym( RTLD_NEXT, "posix_memalign" ) );
+	_libc.aligned_alloc  = reinterpret_cast<decltype(_libc.aligned_alloc )>( dlsym( RTLD_NEXT, "aligned_alloc"  ) );
+	_libc.memalign       = reinterpret_cast<decltype(_libc.memalign      )>( dlsym( RTLD_NEXT, "memalign"       ) );
+	if (
+		_libc.malloc==nullptr || _libc.calloc==nullptr || _libc.realloc==nullptr || _libc.free==nullptr ||
+		_libc.posix_memalign==nullptr || _libc.aligned_alloc==nullptr || _libc.memalign==nullptr
+	) [[unlikely]] {
+		//Nothing sensible to do, and no way to allocate to say so nicely
+		static char const message[] = "TinyLeakCheck: could not find the C library's allocation functions!\n";
+		(void)!write( 2, message, sizeof(message)-1 );
+		abort();
+	}
+
+	_libc_state.store( 2, std::memory_order_release );
+	return true;
+}
+[[nodiscard]] inline static bool _libc_ready() noexcept
+{
+	if ( _libc_state.load(std::memory_order_acquire) == 2 ) [[likely]] return true;
+	return _libc_resolve();
+}
+
+[[nodiscard]] inline static void* _libc_malloc( std::size_t size ) noexcept
+{
+	if ( !_libc_ready() ) [[unlikely]] return _bootstrap_alloc( 1, size );
+	return _libc.malloc(size);
+}
+[[nodiscard]] inline static void* _libc_calloc( std::size_t count, std::size_t size ) noexcept
+{
+	if ( !_libc_ready() ) [[unlikely]]
+	{
+		if ( size!=0 && count>std::numeric_limits<std::size_t>::max()/size ) return nullptr;
+		return _bootstrap_alloc( 1, count*size );
+	}
+	return _libc.calloc( count, size );
+}
+inline static void _libc_free( void* ptr ) noexcept
+{
+	if ( ptr==nullptr || _is_bootstrap(ptr) ) [[unlikely]] return;
+	//(Any other pointer came from the C library, so it has been resolved.)
+	_libc.free(ptr);
+}
+[[nodiscard]] inline static void* _libc_realloc( void* ptr, std::size_t size ) noexcept
+{
+	if ( _is_bootstrap(ptr) || !_libc_ready() ) [[unlikely]]
+	{
+		void* result = _libc_malloc(size);
+		if ( result!=nullptr && ptr!=nullptr )
+		{
+			std::size_t old_size;
+			memcpy( &old_size, static_cast<unsigned char*>(ptr)-sizeof(std::size_t), sizeof(std::size_t) );
+			memcpy( result, ptr, std::min(old_size,size) );
+		}
+		return result;
+	}
+	return _libc.realloc( ptr, size );
+}
+[[nodiscard]] inline static int _libc_posix_memalign(
+	void** result, std::size_t alignment, std::size_t size
+) noexcept {
+	if ( !_libc_ready() ) [[unlikely]]
+	{
+		*result = _bootstrap_alloc( alignment, size );
+		return *result!=nullptr ? 0 : ENOMEM;
+	}
+	return _libc.posix_memalign( result, alignment, size );
+}
+[[nodiscard]] inline static void* _libc_aligned_alloc( std::size_t alignment, std::size_t size ) noexcept
+{
+	if ( !_libc_ready() ) [[unlikely]] return _bootstrap_alloc( alignment, size );
+	return _libc.aligned_alloc( alignment, size );
+}
+[[nodiscard]] inline static void* _libc_memalign( std::size_t alignment, std::size_t size ) noexcept
+{
+	if ( !_libc_ready() ) [[unlikely]] return _bootstrap_alloc( alignment, size );
+	return _libc.memalign( alignment, size );
+}
+
+#else
+
+[[nodiscard]] inline static void* _libc_malloc( std::size_t size ) noexcept { return malloc(size); }
+[[nodiscard]] inline static void* _libc_calloc( std::size_t count, std::size_t size ) noexcept
+{
+	return calloc( count, size );
+}
+inline static void _libc_free( void* ptr ) noexcept { free(ptr); }
+#ifndef _WIN32
+[[nodiscard]] inline static int _libc_posix_memalign(
+	void** result, std::size_t alignment, std::size_t size
+) noexcept {
+	return posix_memalign( result, alignment, size );
+}
+#endif
+
+#endif
+
+
+
 #ifdef _WIN32
 
 inline static void* aligned_malloc( std::size_t alignment, std::size_t size ) noexcept
@@ -98,7 +304,7 @@ static void* aligned_malloc( std::size_t alignment, std::size_t size ) noexcept
 	);
 
 	std::size_t count = alignment-1 + sizeof(TypeOffset) + size;
-	uint8_t* byteptr = static_cast<uint8_t*>( malloc(count) );
+	uint8_t* byteptr = static_cast<uint8_t*>( _libc_malloc(count) );
 
 	size_t offset = alignment - std::bit_cast<uintptr_t>(byteptr)%alignment;
 	if ( offset < sizeof(TypeOffset) ) offset += alignment;
@@ -123,7 +329,7 @@ inline static void aligned_free( void* ptr ) noexcept
 
 	byteptr -= offset;
 
-	free(byteptr);
+	_libc_free(byteptr);
 }
 
 #endif
@@ -156,363 +362,4097 @@ static void str_replace(
 	str_replace( &tmp, str_to_find,str_to_replace_with );
 	return tmp;
 }
-[[nodiscard]] inline static bool str_contains(
-	std::string_view str, std::string_view other
-) noexcept
-{
-	return str.find(other) != std::string::npos;
-}
-
-
 
-#ifdef TINYLEAKCHECK_ENABLED
-MemoryTracer::BlockInfo::BlockInfo(
-	void* ptr, size_t alignment,size_t size, bool with_stacktrace
-) noexcept :
-	ptr(ptr), alignment(alignment),size(size), thread_id(std::this_thread::get_id())
+/*
+Multi-pattern matching, for the prettifying and ignore tables: an Aho-Corasick automaton, built once.
+Transitions are a dense table over just the characters that occur in some pattern (all others share
+class zero, which always leads back to the root), so any text is matched in one pass of table
+lookups.  Matches are leftmost-longest (and among identical patterns, the one listed first).
+*/
+class _PatternMatcher final
 {
-	if ( !with_stacktrace ) [[unlikely]]
-	{
-		//Stack trace was not requested.  This improves performance and is actually necessary e.g.
-		//	when generating the stack trace itself (we'd get infinite recursion).
-		return;
-	}
+	private:
+		std::array< std::uint16_t, 256 > _classes = {};
+		std::size_t _class_count = 1;
+		std::vector<std::uint32_t> _next;    //`[ state*_class_count + class ]`; state zero is the root
+		std::vector<std::uint32_t> _match;   //Per state: one plus the index of the longest pattern ending there, or zero
+		std::vector<std::uint32_t> _depths;  //Per state: length of the prefix it represents
+		std::vector<std::uint32_t> _lengths; //Per pattern
 
-	trace = std::stacktrace( std::stacktrace::current() );
-}
+	public:
+		_PatternMatcher() noexcept : _next(1,0), _match(1,0), _depths(1,0) {}
+		explicit _PatternMatcher( std::span< std::string_view const > patterns );
 
-[[nodiscard]] bool MemoryTracer::BlockInfo::_finalize() const noexcept
-{
-	bool keep = true;
+		[[nodiscard]] bool empty() const noexcept { return _lengths.empty(); }
 
-	struct PrettifyReplacement final { std::string find, replace; };
-	PrettifyReplacement const replacements[] = TINYLEAKCHECK_PRETTIFY_STRS;
-	std::string const ignore_funcs[] = TINYLEAKCHECK_IGNORE_FUNCS;
+		[[nodiscard]] std::uint32_t step( std::uint32_t state, char c ) const noexcept
+		{
+			return _next[ state*_class_count + _classes[ static_cast<std::uint8_t>(c) ] ];
+		}
 
-	//Leak record
-	_str = std::format(
-		"  Leaked {:p} ( align {}, size {}, thread {} )",
-		ptr,
-		alignment, size, thread_id
-	);
+		//Whether any pattern occurs in `str`.
+		[[nodiscard]] bool contains_any( std::string_view str ) const noexcept;
 
-	/*
-	Stack trace
-		We need to pop four times to get to the call site where the memory was allocated:
-			MemoryTracer::BlockInfo::BlockInfo(⋯)
-			MemoryTracer::record_alloc(⋯)
-			_alloc(⋯)
-			operator new(⋯) / operator new[](⋯)
-	*/
-	if ( trace.size() <= 4 ) [[unlikely]]
+		//Replaces each occurrence of pattern `k` in `str` with `replacements[k]`, in one pass.  The
+		//	text is matched as it is rewritten, so a replacement together with the text around it can
+		//	form another match (e.g. "> > >" becomes ">>>" by "> >" → ">>" twice), but text within a
+		//	single replacement is never matched again by itself (so rewriting always terminates).
+		//	Unlike applying the rules one after another, the order of the rules doesn't matter, so a
+		//	rule that matches part of another's pattern (e.g. "std::") can pre-empt it.
+		[[nodiscard]] std::string replace_all(
+			std::string_view str, std::span< std::string const > replacements
+		) const;
+};
+
+_PatternMatcher::_PatternMatcher( std::span< std::string_view const > patterns )
+{
+	for ( std::string_view pattern : patterns )
+	for ( char c : pattern )
 	{
-		_str += '\n';
+		std::uint16_t& char_class = _classes[ static_cast<std::uint8_t>(c) ];
+		if ( char_class == 0 ) char_class=static_cast<std::uint16_t>( _class_count++ );
 	}
-	else
-	{
-		_str += " allocated at:\n";
-		for ( size_t iframe=4; iframe<trace.size(); ++iframe )
-		{
-			std::stacktrace_entry const& frame = trace[iframe];
-
-			std::string descr = frame.description();
-			for ( PrettifyReplacement const& replacement : replacements )
-			{
-				descr = str_get_replaced( descr, replacement.find,replacement.replace );
-			}
-			if (keep)
-			{
-				for ( std::string const& ignore_func : ignore_funcs )
-				{
-					if ( str_contains( descr, ignore_func ) )
-					{
-						keep = false;
-						break;
-					}
-				}
-			}
-
-			std::string frame_str = "    ";
 
-			//frame_str += module;
+	//Trie
+	_next.assign( _class_count, 0 );
+	_match.assign( 1, 0 );
+	_depths.assign( 1, 0 );
+	for ( std::size_t index=0; index<patterns.size(); ++index )
+	{
+		_lengths.push_back( static_cast<std::uint32_t>( patterns[index].size() ) );
+		if ( patterns[index].empty() ) [[unlikely]] continue;
 
-			if ( !descr.empty() ) [[likely]] frame_str += descr;
-			else
+		std::uint32_t state = 0;
+		for ( char c : patterns[index] )
+		{
+			std::size_t edge = state*_class_count + _classes[ static_cast<std::uint8_t>(c) ];
+			if ( _next[edge] == 0 )
 			{
-				//frame_str += std::to_string(return_address);
-				frame_str += "<unknown>";
+				_next[edge] = static_cast<std::uint32_t>( _match.size() );
+				_match.push_back( 0 );
+				_depths.push_back( _depths[state] + 1 );
+				_next.resize( _next.size()+_class_count, 0 );
 			}
+			state = _next[edge];
+		}
+		if ( _match[state] == 0 ) _match[state]=static_cast<std::uint32_t>( index + 1 );
+	}
 
-			std::string filename = frame.source_file();
-			if ( filename.empty() ) [[unlikely]] frame_str += '\n';
+	//Failure links, breadth-first, filling in the missing transitions from the failure state's
+	//	(already complete) ones.  The root's missing transitions just stay at the root.
+	std::vector<std::uint32_t> fail( _match.size(), 0 );
+	std::vector<std::uint32_t> queue;
+	queue.reserve( _match.size() );
+	for ( std::size_t c=1; c<_class_count; ++c )
+	{
+		if ( _next[c] != 0 ) queue.push_back( _next[c] );
+	}
+	for ( std::size_t k=0; k<queue.size(); ++k )
+	{
+		std::uint32_t state = queue[k];
+		std::uint32_t fallback = fail[state];
+		if ( _match[state] == 0 ) _match[state]=_match[fallback]; //(Else this one's longer)
+		for ( std::size_t c=1; c<_class_count; ++c )
+		{
+			std::uint32_t& next = _next[ state*_class_count + c ];
+			std::uint32_t via_fallback = _next[ fallback*_class_count + c ];
+			if ( next == 0 ) next=via_fallback;
 			else
 			{
-				//Take shortest replacement
-				std::string shortest_filename = filename;
-				for ( char const* varname : TINYLEAKCHECK_PRETTIFY_ENVS )
-				{
-					char const* var = std::getenv(varname);
-					if ( var == nullptr ) continue;
-					std::string repl = str_get_replaced(
-						filename, var,std::string("%")+varname+"%"
-					);
-					if ( repl.length() < shortest_filename.length() ) shortest_filename = repl;
-				}
-				filename = shortest_filename;
-
-				frame_str += " at ";
-				frame_str += filename;
-				uint64_t line_no = static_cast<uint64_t>( frame.source_line() );
-				if ( line_no != 0 )
-				{
-					frame_str += std::format( "({})", line_no );
-					//"(%zu,%zu)\n", line,line_offset; //TODO somehow?
-				}
-				frame_str += '\n';
+				fail[next] = via_fallback;
+				queue.push_back( next );
 			}
-
-			_str += frame_str;
 		}
 	}
-
-	_finalized = true;
-
-	return keep;
 }
 
-void MemoryTracer::BlockInfo::basic_print( FILE* file/*=stderr*/ ) const noexcept
+[[nodiscard]] bool _PatternMatcher::contains_any( std::string_view str ) const noexcept
 {
-	if ( !_finalized ) (void)_finalize();
-
-	fprintf( file, "%s", _str.c_str() );
+	std::uint32_t state = 0;
+	for ( char c : str )
+	{
+		state = step( state, c );
+		if ( _match[state] != 0 ) return true;
+	}
+	return false;
 }
 
 
 
-#ifdef __clang__
-	#pragma clang diagnostic push
-	#pragma clang diagnostic ignored "-Wexit-time-destructors"
-	#pragma clang diagnostic ignored "-Wglobal-constructors"
-#endif
-static std::recursive_mutex _memory_tracer_mutex;
-#ifdef __clang__
-	#pragma clang diagnostic pop
-#endif
-static void _default_callback_print_block(
-	MemoryTracer const& /*tracer*/, MemoryTracer::BlockInfo const& block
-) {
-	block.basic_print();
+//The tracer's own long-lived memory (records, stack traces, tables).  This is allocated through
+//	these, so that it's accounted for (see `MemoryTracer::get_overhead_bytes()`).  Each free must
+//	give the size that was allocated.
+static std::atomic<std::size_t> _overhead_bytes = 0;
+[[nodiscard]] inline static void* _overhead_malloc( std::size_t size ) noexcept
+{
+	void* result = _libc_malloc(size);
+	if ( result != nullptr ) [[likely]] _overhead_bytes.fetch_add( size, std::memory_order_relaxed );
+	return result;
 }
-static void _default_callback_post_alloc (
-	MemoryTracer const& /*tracer*/, void* /*ptr*/, size_t /*alignment*/, size_t /*size*/
-) {}
-static void _default_callback_pre_dealloc(
-	MemoryTracer const& /*tracer*/, void* /*ptr*/, size_t /*alignment*/
-) {}
-[[noreturn]] static void _default_callback_leaks_detected( MemoryTracer const& tracer )
+[[nodiscard]] inline static void* _overhead_calloc( std::size_t count, std::size_t size ) noexcept
 {
-	fprintf( stderr, "Leaks detected!\n" );
-	for ( auto const& iter : tracer.blocks )
-	{
-		tracer.callbacks.print_block( tracer, *iter.second );
-	}
-
-	/*
-	Welcome, humble programmer!  I have summoned you here today to help you debug your code.  If you
-	are reading this, you probably have been trapped here by your debugger.  Fear not!  The details
-	of the memory leaks in your code have (by default) been dumped directly into `stderr`!  Fix it!
-	*/
-	#ifndef NDEBUG
-		#if   defined __clang__ || defined __GNUC__
-			__builtin_trap();
-		#elif defined _MSC_VER
-			__debugbreak();
-		#endif
-	#endif
-
-	#ifdef __clang__
-		#pragma clang diagnostic push
-		#pragma clang diagnostic ignored "-Wunreachable-code"
-	#endif
-	std::abort();
-	#ifdef __clang__
-		#pragma clang diagnostic pop
-	#endif
+	void* result = _libc_calloc( count, size );
+	if ( result != nullptr ) [[likely]] _overhead_bytes.fetch_add( count*size, std::memory_order_relaxed );
+	return result;
 }
-
-MemoryTracer::MemoryTracer()
+inline static void _overhead_free( void* ptr, std::size_t size ) noexcept
 {
-	callbacks.print_block    = _default_callback_print_block   ;
-	callbacks.post_alloc     = _default_callback_post_alloc    ;
-	callbacks.pre_dealloc    = _default_callback_pre_dealloc   ;
-	callbacks.leaks_detected = _default_callback_leaks_detected;
+	if ( ptr == nullptr ) return;
+	_overhead_bytes.fetch_sub( size, std::memory_order_relaxed );
+	_libc_free(ptr);
 }
-MemoryTracer::~MemoryTracer()
+
+//Allocator for the tracer's own containers, which must not go through the traced `operator new(⋯)`.
+//	(Not `final`, since standard containers may derive from their allocator.)
+template< class T >
+struct _UntracedAllocator
 {
-	if ( blocks.empty() ) [[likely]] return;
+	using value_type = T;
 
-	memory_tracer->mode.record.push(false); //and don't bother to pop later
+	_UntracedAllocator() noexcept = default;
+	template< class T2 > _UntracedAllocator( _UntracedAllocator<T2> const& ) noexcept {}
 
-	//Final processing on all blocks, calculating prettified strings and removing those which
-	//	should be ignored.
-	for ( auto iter=blocks.cbegin(); iter!=blocks.cend(); )
+	[[nodiscard]] T* allocate( std::size_t count )
 	{
-		BlockInfo const* block = iter->second;
-
-		bool keep = block->_finalize();
-		if (keep) [[unlikely]]
-		{
-			++iter;
-		}
-		else
-		{
-			auto iter_old = iter++;
-			blocks.erase(iter_old);
-			delete block;
-		}
+		void* result = _overhead_malloc( count * sizeof(T) );
+		if ( result == nullptr ) [[unlikely]] throw std::bad_alloc();
+		return static_cast<T*>(result);
 	}
+	void deallocate( T* ptr, std::size_t count ) noexcept { _overhead_free( ptr, count*sizeof(T) ); }
 
-	if ( blocks.empty() ) [[likely]] return;
-
-	//If there are still blocks, then memory leak!
-
-	callbacks.leaks_detected(*this);
-
-	for ( auto iter : blocks )
+	template< class T2 > bool operator==( _UntracedAllocator<T2> const& ) const noexcept
 	{
-		BlockInfo* block = iter.second;
-		delete iter.second;
+		return true;
 	}
-	//blocks.clear();
-}
+};
+template< class Key, class Value >
+using _UntracedMap = std::unordered_map<
+	Key, Value, std::hash<Key>, std::equal_to<Key>,
+	_UntracedAllocator< std::pair<Key const,Value> >
+>;
 
-void MemoryTracer::record_alloc  ( void* ptr, size_t alignment, size_t size )
+/*
+Working memory of `_PatternMatcher::replace_all(⋯)`, kept per thread (reports symbolize on several
+threads at once) and reused, so that rewriting a frame doesn't allocate anything but its result.  It
+doesn't shrink, but it only ever grows to the length of the longest name rewritten.  (A single pass
+over the input isn't possible: replacements are matched again together with the text around them.)
+The report at exit can come after the main thread's thread-locals are destroyed, so then, as on any
+exiting thread, a temporary one is used instead.
+*/
+static thread_local bool _tl_replace_scratch_dead = false;
+struct _ReplaceScratch final
 {
-	std::lock_guard<std::recursive_mutex> lock_raii(_memory_tracer_mutex);
-
-	if ( !mode.record.peek() ) return;
-
-	mode.record.push(false);
+	std::vector< std::uint32_t, _UntracedAllocator<std::uint32_t> > states, origins;
+	std::basic_string< char, std::char_traits<char>, _UntracedAllocator<char> > pending;
+	std::vector< std::uint32_t, _UntracedAllocator<std::uint32_t> > pending_origins;
 
-	blocks.emplace(
-		ptr,
-		new BlockInfo( ptr, alignment, size, mode.with_stacktrace.peek() )
-	);
+	~_ReplaceScratch() noexcept { _tl_replace_scratch_dead=true; }
+};
+//The calling thread's scratch, or `nullptr` if the thread is exiting and it has been destroyed.
+[[nodiscard]] static _ReplaceScratch* _this_thread_replace_scratch() noexcept
+{
+	if ( _tl_replace_scratch_dead ) [[unlikely]] return nullptr;
+	static thread_local _ReplaceScratch scratch;
+	return &scratch;
+}
 
-	callbacks.post_alloc( *this, ptr, alignment, size );
+[[nodiscard]] std::string _PatternMatcher::replace_all(
+	std::string_view str, std::span< std::string const > replacements
+) const {
+	//The output so far, with the automaton's state after each character (so that matching can
+	//	resume from any point, after a match is cut off), and which replacement the character came
+	//	from (zero for `str` itself).  Only the output itself is allocated; the rest is scratch.
+	std::optional<_ReplaceScratch> local;
+	_ReplaceScratch* scratch_ptr = _this_thread_replace_scratch();
+	if ( scratch_ptr == nullptr ) [[unlikely]] scratch_ptr=&local.emplace();
+	_ReplaceScratch& scratch = *scratch_ptr;
+	std::string result;
+	result.reserve( str.size() );
+	auto& states  = scratch.states;
+	auto& origins = scratch.origins;
+	states .clear();
+	origins.clear();
 
-	mode.record.pop();
-}
-void MemoryTracer::record_dealloc( void* ptr, size_t alignment              )
-{
-	if ( ptr == nullptr ) return;
+	//Text still to be fed through (as a stack, so the next character is at the back), initially all
+	//	of `str`.  Replacements, and whatever was fed after the match they replace, go back on top.
+	auto& pending         = scratch.pending;
+	auto& pending_origins = scratch.pending_origins;
+	pending.assign( str.rbegin(), str.rend() );
+	pending_origins.assign( str.size(), 0 );
 
-	std::lock_guard<std::recursive_mutex> lock_raii(_memory_tracer_mutex);
+	//The leftmost(-longest) match so far.  It is only replaced once no partial match that starts
+	//	at or before it remains, since that could still become a longer or earlier one.
+	bool have_match = false;
+	std::size_t match_start=0, match_end=0;
+	std::uint32_t match_pattern = 0;
+	std::uint32_t insertions = 0;
+	std::size_t const max_insertions = 4*str.size() + 64; //Safety net only
 
-	if ( !mode.record.peek() ) return;
+	while ( true )
+	{
+		bool exhausted = pending.empty();
+		if ( !exhausted )
+		{
+			char c = pending.back();
+			std::uint32_t origin = pending_origins.back();
+			pending.pop_back();
+			pending_origins.pop_back();
 
-	mode.record.push(false);
+			std::uint32_t state = step( states.empty() ? 0 : states.back(), c );
+			result .push_back( c );
+			states .push_back( state );
+			origins.push_back( origin );
 
-	callbacks.pre_dealloc( *this, ptr, alignment );
+			if ( std::uint32_t pattern=_match[state]; pattern!=0 && insertions<max_insertions ) [[unlikely]]
+			{
+				std::size_t start = result.size() - _lengths[pattern-1];
+				bool within_one = origin!=0 && std::all_of(
+					origins.begin()+static_cast<std::ptrdiff_t>(start), origins.end(),
+					[origin]( std::uint32_t other ){ return other==origin; }
+				);
+				if ( !within_one && ( !have_match || start<=match_start ) )
+				{
+					have_match    = true;
+					match_start   = start;
+					match_end     = result.size();
+					match_pattern = pattern;
+				}
+			}
+			if ( !have_match || result.size()-_depths[state]<=match_start ) [[likely]] continue;
+		}
+		else if ( !have_match ) break;
 
-	auto iter = blocks.find(ptr);
-	TINYLEAKCHECK_ASSERT( iter!=blocks.cend(), "Deleting an invalid pointer 0x%p!", ptr );
-	delete iter->second;
-	blocks.erase(iter);
+		//Replace the match: re-queue what followed it, then its replacement, and rewind to before it
+		for ( std::size_t k=result.size(); k>match_end; --k )
+		{
+			pending        .push_back( result [k-1] );
+			pending_origins.push_back( origins[k-1] );
+		}
+		std::string const& replacement = replacements[ match_pattern-1 ];
+		++insertions;
+		pending.append( replacement.rbegin(), replacement.rend() );
+		pending_origins.insert( pending_origins.end(), replacement.size(), insertions );
 
-	mode.record.pop();
+		result .resize( match_start );
+		states .resize( match_start );
+		origins.resize( match_start );
+		have_match = false;
+	}
+	return result;
 }
 
 
 
 /*
-When a `MemoryTracer` exists, it can record allocations, and when it's deleted it can report the
-allocations that weren't freed as memory leaks.  So when should the instance `memory_tracer` be
-created and destroyed?
+Stack capture.  We unwind into a buffer with some headroom, and then drop frames up to the one
+returning to the requested call site.  Matching the call site's return address (rather than
+skipping a fixed number of frames) keeps working whatever the compiler decided to inline or
+tail-call inside the tracer.  If the call site isn't found near the top, nothing is dropped.
+*/
+static constexpr std::size_t _stack_headroom = 16;
 
-We can't tie it closely to the `operator new(⋯)` / `operator delete(⋯)` functions, because the
-whole point is that these might be mismatched.  Another alternative is to make the user allocate /
-deallocate it.  This is inconvenient, and of course the user is trying to debug mismatched
-allocation / deallocation in the first place.  The right solution is to make it a namespace-scope
-variable.
+#if   defined TINYLEAKCHECK_UNWIND_STD_STACKTRACE
 
-Note, however, that this solution (along with the previous, as it happens) has a subtle problem:
-allocation can happen during normal runtime, but get freed by the standard library after the fact,
-causing a false positive.  A (real) example is something like:
-	(1) Static construction of `memory_tracer`.
-	(2) Beginning of `main(⋯)`.
-	(3) User code does file IO, standard library allocates memory.
-	(4) End of `main(⋯)`.
-	(5) Static destruction of `memory_tracer`, leaks reported!
-	(6) Standard library cleans up allocated memory.
-This problem cannot be solved "correctly".  The code is functionally correct, and there's no way to
-detect this case.  Since the latest we can run code is with static destructors, we have no way of
-knowing whether the standard library does indeed clean up, or whether it represents a leak.
+TINYLEAKCHECK_NOINLINE static std::size_t _unwind( void** frames, std::size_t max ) noexcept
+{
+	std::stacktrace trace = std::stacktrace::current( 1, max );
+	for ( std::size_t k=0; k<trace.size(); ++k )
+	{
+		frames[k] = std::bit_cast<void*>( static_cast<uintptr_t>( trace[k].native_handle() ) );
+	}
+	return trace.size();
+}
 
-At the same time, constructing the memory leak detector at namespace scope allows us to detect (at
-least some) static memory leaks, which is very useful.  So, we still do this.  The false positives
-are explicitly ignored.
-*/
-MemoryTracer* memory_tracer = nullptr;
-static bool _ready = false;
-inline static void* _alloc  ( size_t alignment, size_t size )
+#elif defined _WIN32
+
+TINYLEAKCHECK_NOINLINE static std::size_t _unwind( void** frames, std::size_t max ) noexcept
 {
-	void* result = aligned_malloc( alignment, size );
-	if (_ready) [[likely]] memory_tracer->record_alloc( result, alignment, size );
-	return result;
+	return RtlCaptureStackBackTrace( 1, static_cast<DWORD>(max), frames, nullptr );
 }
-inline static void  _dealloc( size_t alignment, void* ptr   )
+
+#elif defined TINYLEAKCHECK_UNWIND_FRAME_POINTERS
+
+//Top of the current thread's stack, so that a broken frame-pointer chain can't make us read past it
+//	(the walk starts at the current frame, which bounds it below).  This runs inside the allocation
+//	functions, so it is found without calling anything that might allocate (as does, e.g.,
+//	`pthread_getattr_np(⋯)`, which reads "/proc/self/maps" for the main thread): glibc puts each
+//	thread's descriptor just above its stack, and the main thread's stack ends at `__libc_stack_end`.
+//	The cached top is checked against the current frame on every call, since the same thread may be
+//	running on another stack (e.g. a coroutine's, or a signal handler's alternate stack); if no top
+//	fits, this returns 0, and the caller captures nothing rather than guess at a bound.
+#ifdef __GLIBC__
+	extern "C" void* __libc_stack_end;
+#endif
+static constexpr uintptr_t _stack_size_limit = uintptr_t(1) << 30;
+[[nodiscard]] static bool _is_stack_top_of( uintptr_t top, uintptr_t here ) noexcept
 {
-	if (_ready) [[likely]] memory_tracer->record_dealloc( ptr, alignment );
-	aligned_free(ptr);
+	return here<top && top-here<_stack_size_limit;
 }
-struct _EnsureMemoryTracer final
+[[nodiscard]] static uintptr_t _this_thread_stack_top( uintptr_t here ) noexcept
 {
-	_EnsureMemoryTracer()
+	static thread_local uintptr_t top = 0;
+	if ( !_is_stack_top_of( top, here ) ) [[unlikely]]
 	{
-		memory_tracer = new MemoryTracer;
-		_ready = true;
+		top = 0;
+		#ifdef __GLIBC__
+			auto self     = static_cast<uintptr_t>( pthread_self() );
+			auto main_end = std::bit_cast<uintptr_t>( __libc_stack_end );
+			if      ( _is_stack_top_of( self,     here ) ) top=self;
+			else if ( _is_stack_top_of( main_end, here ) ) top=main_end;
+		#endif
 	}
-	~_EnsureMemoryTracer() noexcept
+	return top;
+}
+TINYLEAKCHECK_NOINLINE static std::size_t _unwind( void** frames, std::size_t max ) noexcept
+{
+	auto lo = std::bit_cast<uintptr_t>( __builtin_frame_address(0) );
+	uintptr_t hi = _this_thread_stack_top(lo);
+	if ( hi == 0 ) [[unlikely]] return 0; //Unknown stack; don't walk it
+
+	//Each frame holds the caller's frame pointer, and above it the return address
+	void** frame = static_cast<void**>( __builtin_frame_address(0) );
+	std::size_t count = 0;
+	while ( count < max )
 	{
-		_ready = false;
-		delete memory_tracer;
-		memory_tracer = nullptr;
-	}
-};
-#ifdef __clang__
-	#pragma clang diagnostic push
-	#pragma clang diagnostic ignored "-Wexit-time-destructors"
-	#pragma clang diagnostic ignored "-Wglobal-constructors"
-#endif
-static _EnsureMemoryTracer _ensure_memory_tracer;
-#ifdef __clang__
-	#pragma clang diagnostic pop
-#endif
-#endif
+		uintptr_t addr = std::bit_cast<uintptr_t>(frame);
+		if (
+			addr<lo || addr+2*sizeof(void*)>hi || addr%sizeof(void*)!=0
+		) [[unlikely]] break;
 
-void prevent_linker_elison() {}
+		void* ret = frame[1];
+		if ( ret == nullptr ) break;
+		frames[count++] = ret;
 
+		void** next = static_cast<void**>( frame[0] );
+		if ( next <= frame ) break; //Stack grows down; the chain must go up
+		frame = next;
+	}
+	return count;
 }
 
-#ifdef TINYLEAKCHECK_ENABLED
+#else
 
-[[nodiscard]] void* operator new( std::size_t size                             )
+struct _UnwindState final { void** frames; std::size_t count, max; bool skipped_self; };
+static _Unwind_Reason_Code _unwind_callback( _Unwind_Context* context, void* state_vp )
 {
-	return TinyLeakCheck::_alloc( __STDCPP_DEFAULT_NEW_ALIGNMENT__, size );
+	_UnwindState* state = static_cast<_UnwindState*>(state_vp);
+	if ( !state->skipped_self ) { state->skipped_self=true; return _URC_NO_REASON; }
+
+	uintptr_t ip = _Unwind_GetIP(context);
+	if ( ip==0 || state->count==state->max ) return _URC_END_OF_STACK;
+	state->frames[ state->count++ ] = std::bit_cast<void*>(ip);
+	return _URC_NO_REASON;
 }
-[[nodiscard]] void* operator new( std::size_t size, std::align_val_t alignment )
+TINYLEAKCHECK_NOINLINE static std::size_t _unwind( void** frames, std::size_t max ) noexcept
 {
-	return TinyLeakCheck::_alloc( static_cast<size_t>(alignment)  , size );
+	//(`_Unwind_Backtrace(⋯)` looks up unwind tables, which libgcc / libunwind cache.)
+	_UnwindState state = { frames, 0, max, false };
+	_Unwind_Backtrace( _unwind_callback, &state );
+	return state.count;
 }
 
-void operator delete( void* ptr                             ) noexcept
+#endif
+
+TINYLEAKCHECK_NOINLINE [[nodiscard]] StackTrace StackTrace::current(
+	void const* call_site/*=nullptr*/
+) noexcept {
+	void* buffer[ max_frames + _stack_headroom ];
+	std::size_t count = _unwind( buffer, max_frames+_stack_headroom );
+
+	//Drop frames up to the call site.  Note that `std::stacktrace` reports addresses one before
+	//	the return address, on some platforms.
+	std::size_t first = 0;
+	if ( call_site == nullptr ) call_site=TINYLEAKCHECK_RETURN_ADDRESS();
+	for ( std::size_t k=0; k<count && k<_stack_headroom; ++k )
+	{
+		uintptr_t addr = std::bit_cast<uintptr_t>( buffer[k] );
+		uintptr_t site = std::bit_cast<uintptr_t>( call_site );
+		if ( addr==site || addr+1==site ) { first=k; break; }
+	}
+
+	StackTrace result;
+	result._count = static_cast<std::uint32_t>( std::min( count-first, max_frames ) );
+	std::copy( buffer+first,buffer+first+result._count, result._frames.data() );
+	return result;
+}
+[[nodiscard]] StackTrace StackTrace::of_call_site( void const* call_site ) noexcept
+{
+	StackTrace result;
+	if ( call_site != nullptr ) [[likely]]
+	{
+		result._count = 1;
+		result._frames[0] = const_cast<void*>(call_site);
+	}
+	return result;
+}
+
+/*
+Symbolization.  Where `std::stacktrace_entry` is just a wrapper around an address (libstdc++ and
+the MSVC STL), we can make one for any address and let the standard library do the work (including
+source locations).  Otherwise, fall back to the dynamic linker's symbol table (function names only).
+*/
+template< class Entry > [[nodiscard]] static StackTrace::Symbol _symbolize( void const* address )
+{
+	StackTrace::Symbol result;
+	if constexpr (
+		sizeof(Entry)==sizeof(uintptr_t) && std::is_trivially_copyable_v<Entry>
+	) {
+		Entry entry = std::bit_cast<Entry>( std::bit_cast<uintptr_t>(address) );
+		result.description = entry.description();
+		result.source_file = entry.source_file();
+		result.source_line = static_cast<std::uint_least32_t>( entry.source_line() );
+	}
+	else
+	{
+		#ifndef _WIN32
+			Dl_info info;
+			if ( dladdr( address, &info )==0 || info.dli_sname==nullptr ) return result;
+
+			int status;
+			char* demangled = abi::__cxa_demangle( info.dli_sname, nullptr,nullptr, &status );
+			result.description = demangled!=nullptr ? demangled : info.dli_sname;
+			free(demangled);
+		#endif
+	}
+	return result;
+}
+[[nodiscard]] StackTrace::Symbol StackTrace::symbolize( void const* return_address )
+{
+	//Look up the call instruction, not whatever follows it
+	uintptr_t addr = std::bit_cast<uintptr_t>(return_address) - 1;
+	return _symbolize<std::stacktrace_entry>( std::bit_cast<void const*>(addr) );
+}
+
+
+
+/*
+Stack depot.  Traces are hashed on their sequence of frames into shards, each with its own lock and
+chained hash table.  Records (and their frames) are bump-allocated from raw `malloc(⋯)`ed arenas, as
+they are never freed.  Ids are handed out sequentially, and an id is mapped back to its record
+through a two-level directory, so `StackDepot::get(⋯)` needs no locking.
+*/
+struct _StackRecord final
+{
+	_StackRecord* next; //Hash chain
+	std::uint64_t hash;
+	std::uint32_t count;
+	StackDepot::Id id;
+
+	[[nodiscard]] void** frames() noexcept { return reinterpret_cast<void**>(this+1); }
+};
+static_assert( sizeof(_StackRecord)%alignof(void*) == 0 );
+
+struct alignas(64) _DepotShard final
+{
+	std::mutex mutex;
+	_StackRecord** buckets = nullptr;
+	std::size_t bucket_count = 0; //Power of two (or zero)
+	std::size_t count = 0;
+	unsigned char* arena = nullptr;
+	std::size_t arena_left = 0;
+};
+static constexpr std::size_t _depot_shard_count = 16;
+static constexpr unsigned    _depot_page_bits   = 12;
+static constexpr std::size_t _depot_arena_size  = 64 * 1024;
+#ifdef __clang__
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wexit-time-destructors"
+	#pragma clang diagnostic ignored "-Wglobal-constructors"
+#endif
+static _DepotShard _depot_shards[ _depot_shard_count ];
+#ifdef __clang__
+	#pragma clang diagnostic pop
+#endif
+static std::atomic<StackDepot::Id> _depot_next_id = 1;
+static std::atomic< std::atomic<_StackRecord*>* > _depot_directory[ 1u << _depot_page_bits ];
+
+[[nodiscard]] static std::uint64_t _hash_frames( void* const* frames, std::size_t count ) noexcept
+{
+	std::uint64_t hash = 0x9E3779B97F4A7C15ull ^ count;
+	for ( std::size_t k=0; k<count; ++k )
+	{
+		hash ^= static_cast<std::uint64_t>( std::bit_cast<uintptr_t>(frames[k]) );
+		hash *= 0xFF51AFD7ED558CCDull;
+		hash ^= hash >> 32;
+	}
+	return hash;
+}
+
+//The directory page holding `id`, created if needed; `nullptr` if the depot is full.
+[[nodiscard]] static std::atomic<_StackRecord*>* _depot_page( StackDepot::Id id ) noexcept
+{
+	if ( id >= (StackDepot::Id(1)<<(2*_depot_page_bits)) ) [[unlikely]] return nullptr;
+
+	std::atomic<std::atomic<_StackRecord*>*>& entry = _depot_directory[ id >> _depot_page_bits ];
+	std::atomic<_StackRecord*>* page = entry.load(std::memory_order_acquire);
+	if ( page != nullptr ) [[likely]] return page;
+
+	//Shards can race to create the page; the loser frees theirs
+	page = static_cast<std::atomic<_StackRecord*>*>(
+		_overhead_calloc( std::size_t(1)<<_depot_page_bits, sizeof(std::atomic<_StackRecord*>) )
+	);
+	if ( page == nullptr ) [[unlikely]] return nullptr;
+	std::atomic<_StackRecord*>* expected = nullptr;
+	if ( !entry.compare_exchange_strong( expected,page, std::memory_order_acq_rel ) )
+	{
+		_overhead_free( page, (std::size_t(1)<<_depot_page_bits)*sizeof(std::atomic<_StackRecord*>) );
+		page = expected;
+	}
+	return page;
+}
+
+[[nodiscard]] StackDepot::Id StackDepot::intern( StackTrace const& trace ) noexcept
+{
+	if ( trace.empty() ) return 0;
+
+	void* const* frames = trace.begin();
+	std::size_t  count  = trace.size();
+	std::uint64_t hash = _hash_frames( frames, count );
+	_DepotShard& shard = _depot_shards[ hash >> 60 & (_depot_shard_count-1) ];
+
+	std::lock_guard lock_raii(shard.mutex);
+
+	if ( shard.bucket_count > 0 ) [[likely]]
+	{
+		for (
+			_StackRecord* record = shard.buckets[ hash & (shard.bucket_count-1) ];
+			record != nullptr;
+			record = record->next
+		) {
+			if (
+				record->hash==hash && record->count==count &&
+				std::equal( frames,frames+count, record->frames() )
+			) [[likely]] return record->id;
+		}
+	}
+
+	//New trace.  Rehash if needed (as with the block registry, load factor of one).
+	if ( shard.count >= shard.bucket_count )
+	{
+		std::size_t new_count = shard.bucket_count==0 ? 256 : 2*shard.bucket_count;
+		_StackRecord** new_buckets = static_cast<_StackRecord**>(
+			_overhead_calloc( new_count, sizeof(_StackRecord*) )
+		);
+		if ( new_buckets != nullptr ) [[likely]]
+		{
+			for ( std::size_t k=0; k<shard.bucket_count; ++k )
+			{
+				for ( _StackRecord* record=shard.buckets[k]; record!=nullptr; )
+				{
+					_StackRecord* next = record->next;
+					_StackRecord*& head = new_buckets[ record->hash & (new_count-1) ];
+					record->next = head;
+					head = record;
+					record = next;
+				}
+			}
+			_overhead_free( shard.buckets, shard.bucket_count*sizeof(_StackRecord*) );
+			shard.buckets      = new_buckets;
+			shard.bucket_count = new_count;
+		}
+		if ( shard.bucket_count == 0 ) [[unlikely]] return 0;
+	}
+
+	std::size_t bytes = sizeof(_StackRecord) + count*sizeof(void*);
+	if ( shard.arena_left < bytes )
+	{
+		shard.arena = static_cast<unsigned char*>( _overhead_malloc(_depot_arena_size) );
+		if ( shard.arena == nullptr ) [[unlikely]] { shard.arena_left=0; return 0; }
+		shard.arena_left = _depot_arena_size;
+	}
+
+	if ( _depot_next_id.load(std::memory_order_relaxed) >= (Id(1)<<(2*_depot_page_bits)) )
+	{
+		return 0; //Full (don't keep counting, or the ids could wrap)
+	}
+	Id id = _depot_next_id.fetch_add( 1, std::memory_order_relaxed );
+	std::atomic<_StackRecord*>* page = _depot_page(id);
+	if ( page == nullptr ) [[unlikely]] return 0;
+
+	_StackRecord* record = reinterpret_cast<_StackRecord*>(shard.arena);
+	shard.arena      += bytes;
+	shard.arena_left -= bytes;
+
+	record->hash  = hash;
+	record->count = static_cast<std::uint32_t>(count);
+	record->id    = id;
+	std::copy( frames,frames+count, record->frames() );
+
+	_StackRecord*& head = shard.buckets[ hash & (shard.bucket_count-1) ];
+	record->next = head;
+	head = record;
+	++shard.count;
+
+	page[ id & ((1u<<_depot_page_bits)-1) ].store( record, std::memory_order_release );
+
+	return id;
+}
+
+[[nodiscard]] std::span< void* const > StackDepot::get( Id id ) noexcept
+{
+	if ( id == 0 ) return {};
+
+	std::atomic<_StackRecord*>* page =
+		_depot_directory[ id >> _depot_page_bits ].load(std::memory_order_acquire);
+	_StackRecord* record = page[ id & ((1u<<_depot_page_bits)-1) ].load(std::memory_order_acquire);
+	return { record->frames(), record->count };
+}
+
+[[nodiscard]] std::size_t StackDepot::size() noexcept
+{
+	return _depot_next_id.load(std::memory_order_relaxed) - 1;
+}
+
+
+
+#ifdef TINYLEAKCHECK_ENABLED
+MemoryTracerBase::BlockInfo::BlockInfo(
+	void* ptr, size_t alignment,size_t size,
+	bool with_stacktrace, void const* call_site
+) noexcept :
+	ptr(ptr), alignment(alignment),size(size), thread_id(std::this_thread::get_id()),
+	//Stack trace may not have been requested, which improves performance.
+	stack_id( with_stacktrace ? StackDepot::intern(StackTrace::current(call_site)) : 0 )
+{}
+
+/*
+Symbolizing and prettifying stack frames, for reports.  Symbolizing is by far the slowest part of
+reporting, and the same frames recur across many stacks, so each distinct return address is
+symbolized and prettified only once per report.  The prettifying tables (and the environment
+variables they refer to) are likewise resolved just once, when the symbolizer is constructed.
+*/
+class _Symbolizer final
+{
+	public:
+		struct Frame final
+		{
+			std::string description; //Prettified (empty if unknown)
+			std::string source_file; //Prettified (empty if unknown)
+			std::uint_least32_t source_line; //(zero if unknown)
+			bool ignored; //Whether inside one of `TINYLEAKCHECK_IGNORE_FUNCS`
+		};
+
+	private:
+		struct _Replacement final { std::string find, replace; };
+		_PatternMatcher _prettify_strs;
+		std::vector<std::string> _prettify_replacements; //For each of `._prettify_strs`' patterns
+		std::vector<_Replacement> _prettify_envs; //Environment variable value to "%⟨varname⟩%"
+		_PatternMatcher _ignore_funcs;
+
+		std::unordered_map< void const*, Frame > _frames;
+
+		template< class GetFrame >
+		static void _append_stack( std::string* str, StackDepot::Id stack_id, GetFrame&& get_frame );
+
+	public:
+		_Symbolizer();
+
+		//Symbolizes and prettifies the frame, without caching it.  Thread-safe.
+		[[nodiscard]] Frame make_frame( void const* return_address ) const;
+		//The cached frame, symbolizing it first if needed.
+		[[nodiscard]] Frame const& frame( void const* return_address );
+		//The cached frame, or else one symbolized into `*made` (which isn't cached).  Only reads the
+		//	cache, so can be called concurrently.
+		[[nodiscard]] Frame const& frame( void const* return_address, Frame* made ) const;
+		[[nodiscard]] bool is_cached( void const* return_address ) const
+		{
+			return _frames.contains(return_address);
+		}
+		void add( void const* return_address, Frame&& frame )
+		{
+			_frames.try_emplace( return_address, std::move(frame) );
+		}
+		//For the shared symbolizer: the cached frame (a copy), symbolizing it outside the lock first
+		//	if needed.
+		[[nodiscard]] Frame shared_frame( void const* return_address );
+
+		[[nodiscard]] bool has_ignores() const noexcept { return !_ignore_funcs.empty(); }
+
+		//Appends the prettified stack trace (or just a newline, if there isn't one) to `str`.  The
+		//	`const` one only reads the cache, like `.frame(⋯,made)`.
+		void append_stack( std::string* str, StackDepot::Id stack_id );
+		void append_stack( std::string* str, StackDepot::Id stack_id ) const;
+		//Whether the stack is *not* to be ignored (i.e., no frame is in an ignored function).
+		[[nodiscard]] bool keep_stack( StackDepot::Id stack_id );
+
+		//Symbolizes every frame of the given stacks that isn't cached yet, in parallel.  Afterward,
+		//	the `const` functions above find all of those stacks' frames in the cache.
+		void prefetch( std::span< StackDepot::Id const > stack_ids );
+};
+
+//Symbolizer of the report in progress on this thread, if any, so that `.basic_print()`s share it.
+static thread_local _Symbolizer* _tl_symbolizer = nullptr;
+//Or, on threads formatting a report together, the symbolizer they share, whose cache they may only
+//	read (so it must have every frame they need already).
+static thread_local _Symbolizer const* _tl_shared_symbolizer = nullptr;
+//The same, for the report at exit, so that the threads it formats on can share it too.
+static _Symbolizer* _symbolizer_of_report = nullptr;
+//Guards the cache of the process-wide symbolizer (see below), which unlike the others is shared
+//	between threads while the program runs.
+#ifdef __clang__
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wexit-time-destructors"
+	#pragma clang diagnostic ignored "-Wglobal-constructors"
+#endif
+static std::mutex _shared_symbolizer_mutex;
+#ifdef __clang__
+	#pragma clang diagnostic pop
+#endif
+
+//Set while the current thread is inside the tracer (or a callback), so that allocations made there
+//	are not themselves recorded.
+static thread_local bool _tl_internal = false;
+//Depth of `BlockRegistry::_WalkScope`s on the current thread.
+static thread_local unsigned _tl_walking = 0;
+
+/*
+Runs `fn(begin,end)` on contiguous slices of the range [0,`count`), spread over up to one thread per
+hardware thread (the calling thread included, and all of them internal).  Slices are at least `grain`
+long, so that small jobs just run on the calling thread.  Used for the expensive parts of reporting.
+*/
+template< class Fn > static void _parallel_for( std::size_t count, std::size_t grain, Fn const& fn )
+{
+	std::size_t threads = std::min<std::size_t>(
+		std::max( std::thread::hardware_concurrency(), 1u ), (count+grain-1)/grain
+	);
+	if ( threads <= 1 )
+	{
+		fn( 0, count );
+		return;
+	}
+
+	std::size_t per_thread = ( count + threads - 1 ) / threads;
+	std::vector<std::thread> workers;
+	workers.reserve( threads - 1 );
+	for ( std::size_t begin=per_thread; begin<count; begin+=per_thread )
+	{
+		std::size_t end = std::min( begin+per_thread, count );
+		try
+		{
+			workers.emplace_back( [&fn,begin,end]()
+			{
+				_tl_internal = true;
+				fn( begin, end );
+			} );
+		}
+		catch ( std::system_error const& ) { fn(begin,end); } //Out of threads; do it here instead
+	}
+	fn( 0, per_thread );
+	for ( std::thread& worker : workers ) worker.join();
+}
+
+_Symbolizer::_Symbolizer()
+{
+	_Replacement const replacements[] = TINYLEAKCHECK_PRETTIFY_STRS;
+	std::vector<std::string_view> patterns;
+	for ( _Replacement const& replacement : replacements )
+	{
+		patterns.push_back( replacement.find );
+		_prettify_replacements.push_back( replacement.replace );
+	}
+	_prettify_strs = _PatternMatcher( patterns );
+
+	for ( char const* varname : TINYLEAKCHECK_PRETTIFY_ENVS )
+	{
+		char const* var = std::getenv(varname);
+		if ( var==nullptr || *var=='\0' ) continue;
+		_prettify_envs.push_back({ var, std::string("%")+varname+"%" });
+	}
+
+	std::string const ignore_funcs[] = TINYLEAKCHECK_IGNORE_FUNCS;
+	patterns.assign( std::begin(ignore_funcs),std::end(ignore_funcs) );
+	_ignore_funcs = _PatternMatcher( patterns );
+}
+
+[[nodiscard]] _Symbolizer::Frame _Symbolizer::make_frame( void const* return_address ) const
+{
+	Frame frame;
+	StackTrace::Symbol symbol = StackTrace::symbolize(return_address);
+
+	frame.description = _prettify_strs.replace_all( symbol.description, _prettify_replacements );
+	frame.ignored = _ignore_funcs.contains_any( frame.description );
+
+	//Take shortest replacement
+	frame.source_file = std::move(symbol.source_file);
+	if ( !frame.source_file.empty() ) [[likely]]
+	{
+		std::string shortest_filename = frame.source_file;
+		for ( _Replacement const& replacement : _prettify_envs )
+		{
+			std::string repl = str_get_replaced(
+				frame.source_file, replacement.find,replacement.replace
+			);
+			if ( repl.length() < shortest_filename.length() ) shortest_filename=std::move(repl);
+		}
+		frame.source_file = std::move(shortest_filename);
+	}
+	frame.source_line = symbol.source_line;
+
+	return frame;
+}
+[[nodiscard]] _Symbolizer::Frame _Symbolizer::shared_frame( void const* return_address )
+{
+	{
+		std::lock_guard lock_raii(_shared_symbolizer_mutex);
+		if ( auto iter=_frames.find(return_address); iter!=_frames.end() ) return iter->second;
+	}
+	Frame made = make_frame(return_address);
+	std::lock_guard lock_raii(_shared_symbolizer_mutex);
+	return _frames.try_emplace( return_address, std::move(made) ).first->second;
+}
+[[nodiscard]] _Symbolizer::Frame const& _Symbolizer::frame( void const* return_address )
+{
+	auto iter = _frames.find( return_address );
+	if ( iter != _frames.end() ) [[likely]] return iter->second;
+	return _frames.try_emplace( return_address, make_frame(return_address) ).first->second;
+}
+[[nodiscard]] _Symbolizer::Frame const& _Symbolizer::frame( void const* return_address, Frame* made ) const
+{
+	auto iter = _frames.find( return_address );
+	if ( iter != _frames.end() ) [[likely]] return iter->second;
+	*made = make_frame(return_address);
+	return *made;
+}
+
+template< class GetFrame >
+void _Symbolizer::_append_stack( std::string* str, StackDepot::Id stack_id, GetFrame&& get_frame )
+{
+	//Internal frames were already dropped when the trace was captured
+	std::span< void* const > trace = StackDepot::get(stack_id);
+	if ( trace.empty() ) [[unlikely]]
+	{
+		*str += '\n';
+		return;
+	}
+
+	*str += " allocated at:\n";
+	for ( void* return_address : trace )
+	{
+		Frame const& frame = get_frame(return_address);
+
+		*str += "    ";
+
+		//*str += module;
+
+		if ( !frame.description.empty() ) [[likely]] *str += frame.description;
+		else
+		{
+			//*str += std::to_string(return_address);
+			*str += "<unknown>";
+		}
+
+		if ( !frame.source_file.empty() ) [[likely]]
+		{
+			*str += " at ";
+			*str += frame.source_file;
+			if ( frame.source_line != 0 )
+			{
+				*str += std::format( "({})", frame.source_line );
+				//"(%zu,%zu)\n", line,line_offset; //TODO somehow?
+			}
+		}
+		*str += '\n';
+	}
+}
+void _Symbolizer::append_stack( std::string* str, StackDepot::Id stack_id )
+{
+	_append_stack( str, stack_id, [this]( void const* return_address ) -> Frame const&
+	{
+		return frame(return_address);
+	} );
+}
+void _Symbolizer::append_stack( std::string* str, StackDepot::Id stack_id ) const
+{
+	Frame made;
+	_append_stack( str, stack_id, [this,&made]( void const* return_address ) -> Frame const&
+	{
+		return frame( return_address, &made );
+	} );
+}
+[[nodiscard]] bool _Symbolizer::keep_stack( StackDepot::Id stack_id )
+{
+	for ( void* return_address : StackDepot::get(stack_id) )
+	{
+		if ( frame(return_address).ignored ) return false;
+	}
+	return true;
+}
+void _Symbolizer::prefetch( std::span< StackDepot::Id const > stack_ids )
+{
+	std::vector< void const* > missing;
+	for ( StackDepot::Id stack_id : stack_ids )
+	{
+		for ( void* return_address : StackDepot::get(stack_id) )
+		{
+			if ( !is_cached(return_address) ) missing.push_back(return_address);
+		}
+	}
+	std::sort( missing.begin(), missing.end() );
+	missing.erase( std::unique( missing.begin(),missing.end() ), missing.end() );
+
+	//`.make_frame(⋯)` only reads the tables, so the workers can share them
+	std::vector<Frame> made( missing.size() );
+	_parallel_for( missing.size(), 64, [&]( std::size_t begin, std::size_t end )
+	{
+		for ( std::size_t k=begin; k<end; ++k ) made[k]=make_frame( missing[k] );
+	} );
+	for ( std::size_t k=0; k<missing.size(); ++k ) add( missing[k], std::move(made[k]) );
+}
+
+//Appends the stack with the symbolizer of the report in progress on this thread, if any (see
+//	`_tl_shared_symbolizer` / `_tl_symbolizer`), or else a new one.
+static void _append_stack_for_report( std::string* str, StackDepot::Id stack_id )
+{
+	if      ( _tl_shared_symbolizer != nullptr ) _tl_shared_symbolizer->append_stack( str, stack_id );
+	else if ( _tl_symbolizer        != nullptr ) _tl_symbolizer       ->append_stack( str, stack_id );
+	else
+	{
+		_Symbolizer local;
+		local.append_stack( str, stack_id );
+	}
+}
+
+void MemoryTracerBase::BlockInfo::basic_print( FILE* file/*=stderr*/ ) const noexcept
+{
+	std::string str = std::format(
+		"  Leaked {:p} ( align {}, size {}, thread {} )",
+		ptr,
+		alignment, size, thread_id
+	);
+
+	_append_stack_for_report( &str, stack_id );
+
+	fprintf( file, "%s", str.c_str() );
+}
+
+void MemoryTracerBase::Site::basic_print( FILE* file/*=stderr*/ ) const noexcept
+{
+	std::string str;
+	basic_format( &str );
+	fprintf( file, "%s", str.c_str() );
+}
+void MemoryTracerBase::Site::basic_format( std::string* str ) const
+{
+	if ( count==1 && sample_count==1 )
+	{
+		*str += std::format( "  Leaked {:p} ( size {} )", samples[0], bytes );
+	}
+	else
+	{
+		*str += std::format( "  Leaked {} blocks ( total size {}", count, bytes );
+		for ( std::size_t k=0; k<sample_count; ++k )
+		{
+			*str += std::format( k==0 ? "; e.g. {:p}" : ", {:p}", samples[k] );
+		}
+		*str += count>sample_count && sample_count>0 ? ", ⋯ )" : " )";
+	}
+	if ( estimated_count != static_cast<double>(count) )
+	{
+		*str += std::format(
+			" ( sampled; estimated {:.0f} blocks, {:.0f} bytes )", estimated_count,estimated_bytes
+		);
+	}
+
+	_append_stack_for_report( str, stack_id );
+}
+
+
+
+MemoryTracerBase::InternalScope::InternalScope() noexcept :
+	_was_internal(_tl_internal)
+{
+	_tl_internal = true;
+}
+MemoryTracerBase::InternalScope::~InternalScope() noexcept
+{
+	_tl_internal = _was_internal;
+}
+
+MemoryTracerBase::BlockRegistry::_WalkScope::_WalkScope() noexcept
+{
+	++_tl_walking;
+}
+MemoryTracerBase::BlockRegistry::_WalkScope::~_WalkScope() noexcept
+{
+	--_tl_walking;
+}
+
+
+
+MemoryTracerBase::BlockRegistry::~BlockRegistry() noexcept
+{
+	for ( Shard& shard : _shards ) _overhead_free( shard.buckets, shard.bucket_count*sizeof(BlockInfo*) );
+}
+
+[[nodiscard]] std::uint64_t MemoryTracerBase::BlockRegistry::_hash( void const* ptr ) noexcept
+{
+	//Fibonacci hashing; the low bits of a pointer are mostly alignment, so mix them upward.
+	std::uint64_t hash = static_cast<std::uint64_t>( std::bit_cast<uintptr_t>(ptr) );
+	hash ^= hash >> 4;
+	return hash * 0x9E3779B97F4A7C15ull;
+}
+[[nodiscard]] MemoryTracerBase::BlockRegistry::Shard& MemoryTracerBase::BlockRegistry::_shard_for(
+	std::uint64_t hash
+) noexcept {
+	//Shard from the high bits, bucket from lower ones (see `.insert(⋯)` / `.extract(⋯)`).
+	return _shards[ hash >> 48 & (TINYLEAKCHECK_REGISTRY_SHARDS-1) ];
+}
+void MemoryTracerBase::BlockRegistry::_grow( Shard* shard ) noexcept
+{
+	std::size_t new_count = shard->bucket_count==0 ? 64 : 2*shard->bucket_count;
+	BlockInfo** new_buckets = static_cast<BlockInfo**>( _overhead_calloc( new_count, sizeof(BlockInfo*) ) );
+	if ( new_buckets == nullptr ) [[unlikely]] return; //Just run at a higher load factor
+
+	for ( std::size_t k=0; k<shard->bucket_count; ++k )
+	{
+		for ( BlockInfo* block=shard->buckets[k]; block!=nullptr; )
+		{
+			BlockInfo* next = block->_next;
+			BlockInfo*& head = new_buckets[ _hash(block->ptr)>>24 & (new_count-1) ];
+			block->_next = head;
+			if ( head != nullptr ) head->_link=&block->_next;
+			block->_link = &head;
+			head = block;
+			block = next;
+		}
+	}
+
+	_overhead_free( shard->buckets, shard->bucket_count*sizeof(BlockInfo*) );
+	shard->buckets      = new_buckets;
+	shard->bucket_count = new_count;
+}
+
+void MemoryTracerBase::BlockRegistry::insert( BlockInfo* block ) noexcept
+{
+	std::uint64_t hash = _hash(block->ptr);
+	Shard& shard = _shard_for(hash);
+
+	std::lock_guard lock_raii(shard.mutex);
+	_insert_locked( &shard, hash, block );
+}
+void MemoryTracerBase::BlockRegistry::insert_batch(
+	BlockInfo* const* blocks, std::size_t count
+) noexcept {
+	constexpr std::size_t chunk = 64;
+	for ( ; count>chunk; blocks+=chunk,count-=chunk ) insert_batch( blocks, chunk );
+
+	std::uint64_t hashes[chunk];
+	Shard*        shards[chunk];
+	for ( std::size_t k=0; k<count; ++k )
+	{
+		hashes[k] = _hash( blocks[k]->ptr );
+		shards[k] = &_shard_for( hashes[k] );
+	}
+
+	//Lock the first remaining block's shard, and insert every remaining block belonging to it.
+	for ( std::size_t k=0; k<count; ++k )
+	{
+		Shard* shard = shards[k];
+		if ( shard == nullptr ) continue;
+
+		std::lock_guard lock_raii(shard->mutex);
+		for ( std::size_t j=k; j<count; ++j )
+		{
+			if ( shards[j] != shard ) continue;
+			_insert_locked( shard, hashes[j], blocks[j] );
+			shards[j] = nullptr;
+		}
+	}
+}
+void MemoryTracerBase::BlockRegistry::_insert_locked(
+	Shard* shard, std::uint64_t hash, BlockInfo* block
+) noexcept {
+	if ( shard->count >= shard->bucket_count ) [[unlikely]] _grow(shard);
+	TINYLEAKCHECK_ASSERT( shard->bucket_count>0, "Could not allocate block registry!" );
+
+	BlockInfo*& head = shard->buckets[ hash>>24 & (shard->bucket_count-1) ];
+	block->_next = head;
+	if ( head != nullptr ) head->_link=&block->_next;
+	block->_link = &head;
+	head = block;
+	++shard->count;
+
+	_link_ages( shard, block );
+
+	//No longer pending in a log (if it was).  Cleared while the shard is still locked, so that a
+	//	thread which sees no log and goes looking for the block here always finds it, and can't
+	//	retire (and the pool reuse) the record before this store.
+	block->_log.store( nullptr, std::memory_order_release );
+}
+void MemoryTracerBase::BlockRegistry::_advance_ages(
+	AgeLists* lists, AgeLink by, std::uint64_t age
+) noexcept {
+	//Ages falling out of the ring join the ancient list (each block moves at most once)
+	for (
+		std::uint64_t leaving = lists->newest + 1;
+		leaving<=age && leaving<=lists->newest+age_ring;
+		++leaving
+	) {
+		BlockInfo*& list = lists->recent[ leaving % age_ring ];
+		if ( list == nullptr ) continue;
+
+		BlockInfo* tail = list;
+		while ( (tail->*by).next != nullptr ) tail=(tail->*by).next;
+		(tail->*by).next = lists->ancient;
+		if ( lists->ancient != nullptr ) (lists->ancient->*by).link=&(tail->*by).next;
+		lists->ancient = list;
+		(list->*by).link = &lists->ancient;
+		list = nullptr;
+	}
+	lists->newest = age;
+}
+void MemoryTracerBase::BlockRegistry::_link_age(
+	AgeLists* lists, AgeLink by, BlockInfo* block, std::uint64_t age
+) noexcept {
+	if ( age > lists->newest ) [[unlikely]] _advance_ages( lists, by, age );
+
+	BlockInfo** list = age+age_ring <= lists->newest ? &lists->ancient : &lists->recent[ age % age_ring ];
+	BlockInfo::_AgeLink& self = block->*by;
+	self.next = *list;
+	if ( *list != nullptr ) ((*list)->*by).link=&self.next;
+	self.link = list;
+	*list = block;
+}
+[[nodiscard]] MemoryTracerBase::BlockInfo* MemoryTracerBase::BlockRegistry::extract(
+	void const* ptr
+) noexcept {
+	std::uint64_t hash = _hash(ptr);
+	Shard& shard = _shard_for(hash);
+
+	std::lock_guard lock_raii(shard.mutex);
+
+	if ( shard.bucket_count == 0 ) [[unlikely]] return nullptr;
+	for (
+		BlockInfo** link = shard.buckets + ( hash>>24 & (shard.bucket_count-1) );
+		*link != nullptr;
+		link = &(*link)->_next
+	) {
+		BlockInfo* block = *link;
+		if ( block->ptr == ptr )
+		{
+			_unlink_locked( &shard, block );
+			return block;
+		}
+	}
+	return nullptr;
+}
+void MemoryTracerBase::BlockRegistry::unlink( BlockInfo* block ) noexcept
+{
+	Shard& shard = _shard_for( _hash(block->ptr) );
+
+	std::lock_guard lock_raii(shard.mutex);
+	TINYLEAKCHECK_ASSERT( *block->_link==block, "Implementation error!" );
+	_unlink_locked( &shard, block );
+}
+
+[[nodiscard]] std::size_t MemoryTracerBase::BlockRegistry::size() const noexcept
+{
+	std::size_t count = 0;
+	for ( Shard const& shard : _shards )
+	{
+		std::lock_guard lock_raii(shard.mutex);
+		count += shard.count;
+	}
+	return count;
+}
+
+
+
+/*
+Pool for `BlockInfo` records.  Each traced allocation needs one record, so getting these from the
+traced heap would double the number of heap operations (and recurse into the tracer).  Instead,
+records are carved from raw `malloc(⋯)`ed chunks and recycled through intrusive free lists: each
+thread keeps a small cache, and trades batches with a shared list when it runs dry or overflows.
+
+Every record also has a dense index (its "slot"), so that a record can be named by a 32-bit number.
+Chunks are located through a two-level directory, which is filled in once and never moved, so
+`_BlockPool::at(⋯)` needs no locking.  Chunks are never returned; they are just reused.
+*/
+union _BlockSlot final
+{
+	struct Free final
+	{
+		_BlockSlot* next;
+		std::uint32_t index;
+	} free;
+	alignas(MemoryTracer::BlockInfo) unsigned char storage[ sizeof(MemoryTracer::BlockInfo) ];
+};
+
+class _BlockPool final
+{
+	public:
+		using BlockInfo = MemoryTracer::BlockInfo;
+
+		static constexpr std::uint32_t chunk_bits = 10; //Records per chunk, and chunks per page
+		static constexpr std::uint32_t chunk_size = 1u << chunk_bits;
+
+	private:
+		static constexpr std::size_t _cache_max   = 256; //Per-thread free records
+		static constexpr std::size_t _cache_batch = 128; //Records moved to/from the shared list
+
+		struct _Cache final
+		{
+			_BlockSlot* head = nullptr;
+			std::size_t count = 0;
+			~_Cache() noexcept;
+		};
+		static thread_local bool _tl_cache_dead;
+
+		static std::mutex _mutex;
+		static _BlockSlot* _shared_head;
+		static std::uint32_t _slots_carved;
+		static std::atomic<_BlockSlot**> _directory[ std::size_t(1) << (32-2*chunk_bits) ];
+
+	public:
+		template< class... Ts > [[nodiscard]] static BlockInfo* create( Ts&&... args ) noexcept
+		{
+			_BlockSlot* slot = _take();
+			if ( slot == nullptr ) [[unlikely]] return nullptr;
+
+			std::uint32_t index = slot->free.index;
+			BlockInfo* block = new(slot->storage) BlockInfo( std::forward<Ts>(args)... );
+			block->_slot = index;
+			return block;
+		}
+		static void destroy( BlockInfo const* block ) noexcept
+		{
+			std::uint32_t index = block->_slot;
+			block->~BlockInfo();
+
+			_BlockSlot* slot = reinterpret_cast<_BlockSlot*>( const_cast<BlockInfo*>(block) );
+			slot->free.index = index;
+			_give(slot);
+		}
+
+		//The record in the given slot.  Only meaningful for slots that are currently in use.
+		[[nodiscard]] static BlockInfo* at( std::uint32_t index ) noexcept
+		{
+			_BlockSlot** chunks = _directory[ index >> (2*chunk_bits) ].load(std::memory_order_acquire);
+			_BlockSlot* chunk = chunks[ index>>chunk_bits & (chunk_size-1) ];
+			return reinterpret_cast<BlockInfo*>( chunk[ index & (chunk_size-1) ].storage );
+		}
+
+	private:
+		[[nodiscard]] static _Cache* _this_thread_cache() noexcept
+		{
+			if ( _tl_cache_dead ) [[unlikely]] return nullptr;
+			static thread_local _Cache cache;
+			return &cache;
+		}
+
+		//Carves a new chunk onto the shared list.  Caller must hold `_mutex`.
+		static bool _carve() noexcept;
+
+		[[nodiscard]] static _BlockSlot* _take() noexcept;
+		static void _give( _BlockSlot* slot ) noexcept;
+};
+thread_local bool _BlockPool::_tl_cache_dead = false;
+#ifdef __clang__
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wexit-time-destructors"
+	#pragma clang diagnostic ignored "-Wglobal-constructors"
+#endif
+std::mutex _BlockPool::_mutex;
+#ifdef __clang__
+	#pragma clang diagnostic pop
+#endif
+_BlockSlot* _BlockPool::_shared_head = nullptr;
+std::uint32_t _BlockPool::_slots_carved = 0;
+std::atomic<_BlockSlot**> _BlockPool::_directory[ std::size_t(1) << (32-2*chunk_bits) ];
+
+_BlockPool::_Cache::~_Cache() noexcept
+{
+	_tl_cache_dead = true;
+	if ( head == nullptr ) return;
+
+	_BlockSlot* tail = head;
+	while ( tail->free.next != nullptr ) tail=tail->free.next;
+
+	std::lock_guard lock_raii(_mutex);
+	tail->free.next = _shared_head;
+	_shared_head = head;
+}
+
+bool _BlockPool::_carve() noexcept
+{
+	std::uint32_t index0 = _slots_carved;
+	if ( index0 > std::numeric_limits<std::uint32_t>::max()-chunk_size ) [[unlikely]] return false;
+
+	std::atomic<_BlockSlot**>& page = _directory[ index0 >> (2*chunk_bits) ];
+	_BlockSlot** chunks = page.load(std::memory_order_relaxed);
+	if ( chunks == nullptr )
+	{
+		chunks = static_cast<_BlockSlot**>( _overhead_calloc( chunk_size, sizeof(_BlockSlot*) ) );
+		if ( chunks == nullptr ) [[unlikely]] return false;
+		page.store( chunks, std::memory_order_release );
+	}
+
+	_BlockSlot* chunk = static_cast<_BlockSlot*>( _overhead_malloc( chunk_size*sizeof(_BlockSlot) ) );
+	if ( chunk == nullptr ) [[unlikely]] return false;
+	chunks[ index0>>chunk_bits & (chunk_size-1) ] = chunk;
+
+	for ( std::uint32_t k=chunk_size; k-->0; )
+	{
+		chunk[k].free.next  = _shared_head;
+		chunk[k].free.index = index0 + k;
+		_shared_head = chunk + k;
+	}
+	_slots_carved += chunk_size;
+	return true;
+}
+
+[[nodiscard]] _BlockSlot* _BlockPool::_take() noexcept
+{
+	_Cache* cache = _this_thread_cache();
+	if ( cache==nullptr || cache->head==nullptr ) [[unlikely]]
+	{
+		std::lock_guard lock_raii(_mutex);
+		if ( _shared_head==nullptr && !_carve() ) [[unlikely]] return nullptr;
+
+		_BlockSlot* slot = _shared_head;
+		_shared_head = slot->free.next;
+		if ( cache == nullptr ) [[unlikely]] return slot;
+
+		//Refill the cache with a batch while we hold the lock
+		for ( std::size_t k=0; k<_cache_batch && _shared_head!=nullptr; ++k )
+		{
+			_BlockSlot* moved = _shared_head;
+			_shared_head = moved->free.next;
+			moved->free.next = cache->head;
+			cache->head = moved;
+			++cache->count;
+		}
+		return slot;
+	}
+
+	_BlockSlot* slot = cache->head;
+	cache->head = slot->free.next;
+	--cache->count;
+	return slot;
+}
+void _BlockPool::_give( _BlockSlot* slot ) noexcept
+{
+	_Cache* cache = _this_thread_cache();
+	if ( cache == nullptr ) [[unlikely]]
+	{
+		std::lock_guard lock_raii(_mutex);
+		slot->free.next = _shared_head;
+		_shared_head = slot;
+		return;
+	}
+
+	slot->free.next = cache->head;
+	cache->head = slot;
+	if ( ++cache->count <= _cache_max ) [[likely]] return;
+
+	//Overflowed; return a batch to the shared list
+	_BlockSlot* first = cache->head;
+	_BlockSlot* last  = first;
+	for ( std::size_t k=1; k<_cache_batch; ++k ) last=last->free.next;
+	cache->head = last->free.next;
+	cache->count -= _cache_batch;
+
+	std::lock_guard lock_raii(_mutex);
+	last->free.next = _shared_head;
+	_shared_head = first;
+}
+
+
+
+/*
+Per-thread log of recently allocated blocks which have not yet been published to the shared
+`.blocks` registry.  Most short-lived allocations are freed by the same thread that made them, so
+the allocation / deallocation pair cancels out here without touching the registry.  The survivors
+are published in batches: the older half when the log overflows, and all of them on thread exit or
+`MemoryTracer::flush()`.
+
+Another thread may free a block that is still pending here.  With in-band headers, that thread has
+the block's record, which names the log (`._log`), so it locks just that one.  Otherwise, it misses
+in the registry, and then searches the other threads' logs (see `_extract_from_thread_logs(⋯)`).
+Each log has a mutex for that reason, but it is essentially never contended.  Logs are never freed:
+when its thread exits, a log is published and goes onto a free list, for the next new thread to
+reuse.  So a record's `._log` always names a live mutex, even if the thread has since exited.  Lock
+order is: `_thread_logs_mutex`, then a log's `.mutex`, then registry shards.
+*/
+static_assert( TINYLEAKCHECK_THREAD_LOG_SIZE >= 2, "Thread log is too small!" );
+struct _ThreadLog final
+{
+	std::mutex mutex;
+	MemoryTracer::BlockInfo* pending[ TINYLEAKCHECK_THREAD_LOG_SIZE ]; //Oldest first
+	std::size_t count = 0;
+
+	_ThreadLog* next      = nullptr; //In `_thread_logs`, which has every log ever made
+	_ThreadLog* next_free = nullptr; //While on `_thread_logs_free`
+
+	//Adds a block, publishing the older half first if full.  Caller must hold `.mutex`.
+	void push( MemoryTracer::BlockInfo* block ) noexcept;
+	//Publishes the `num` oldest pending blocks to the registry.  Caller must hold `.mutex`.
+	void publish_oldest( std::size_t num ) noexcept;
+	//Removes and returns the pending block for `ptr`, or `nullptr`.  Caller must hold `.mutex`.
+	[[nodiscard]] MemoryTracer::BlockInfo* extract( void const* ptr ) noexcept;
+};
+#ifdef __clang__
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wexit-time-destructors"
+	#pragma clang diagnostic ignored "-Wglobal-constructors"
+#endif
+static std::mutex _thread_logs_mutex;
+#ifdef __clang__
+	#pragma clang diagnostic pop
+#endif
+static _ThreadLog* _thread_logs      = nullptr; //Guarded by `_thread_logs_mutex`
+static _ThreadLog* _thread_logs_free = nullptr; //Likewise
+static thread_local _ThreadLog* _tl_log = nullptr;
+static thread_local bool _tl_log_dead = false; //If so, this thread has no log (any more)
+
+void _ThreadLog::push( MemoryTracer::BlockInfo* block ) noexcept
+{
+	if ( count == TINYLEAKCHECK_THREAD_LOG_SIZE ) [[unlikely]]
+	{
+		//Keep the newer half, as those are the most likely to be freed soon.
+		publish_oldest( TINYLEAKCHECK_THREAD_LOG_SIZE / 2 );
+	}
+	pending[ count++ ] = block;
+	block->_log.store( this, std::memory_order_relaxed );
+}
+void _ThreadLog::publish_oldest( std::size_t num ) noexcept
+{
+	memory_tracer->blocks.insert_batch( pending, num ); //(Which clears their `._log`s)
+	std::copy( pending+num,pending+count, pending );
+	count -= num;
+}
+[[nodiscard]] MemoryTracer::BlockInfo* _ThreadLog::extract( void const* ptr ) noexcept
+{
+	//Newest first, since short-lived blocks are the ones we expect to find
+	for ( std::size_t k=count; k-->0; )
+	{
+		MemoryTracer::BlockInfo* block = pending[k];
+		if ( block->ptr == ptr )
+		{
+			std::copy( pending+k+1,pending+count, pending+k );
+			--count;
+			block->_log.store( nullptr, std::memory_order_relaxed );
+			return block;
+		}
+	}
+	return nullptr;
+}
+
+//Gives the thread's log back when it exits.
+struct _ThreadLogLease final
+{
+	~_ThreadLogLease() noexcept
+	{
+		_tl_log_dead = true;
+		_ThreadLog* log = _tl_log;
+		_tl_log = nullptr;
+
+		//Publish while still locked, so that a concurrent search always finds the block in one
+		//	place or the other.
+		{
+			std::lock_guard lock_raii(log->mutex);
+			if ( memory_tracer != nullptr ) [[likely]] log->publish_oldest( log->count );
+			else
+			{
+				//Too late to report anything
+				for ( std::size_t k=0; k<log->count; ++k ) _BlockPool::destroy( log->pending[k] );
+				log->count = 0;
+			}
+		}
+
+		std::lock_guard lock_raii(_thread_logs_mutex);
+		log->next_free = _thread_logs_free;
+		_thread_logs_free = log;
+	}
+};
+//A free log, else a new one, or `nullptr` if the tracer is out of memory.
+[[nodiscard]] static _ThreadLog* _thread_log_acquire() noexcept
+{
+	std::lock_guard lock_raii(_thread_logs_mutex);
+	if ( _ThreadLog* log=_thread_logs_free; log!=nullptr )
+	{
+		_thread_logs_free = log->next_free;
+		log->next_free = nullptr;
+		return log;
+	}
+	void* memory = _overhead_malloc( sizeof(_ThreadLog) );
+	if ( memory == nullptr ) [[unlikely]] return nullptr;
+	_ThreadLog* log = new(memory) _ThreadLog;
+	log->next = _thread_logs;
+	_thread_logs = log;
+	return log;
+}
+
+//The calling thread's log, or `nullptr` if it has none (e.g. it is exiting, and gave it back).
+[[nodiscard]] static _ThreadLog* _this_thread_log() noexcept
+{
+	if ( _tl_log != nullptr ) [[likely]] return _tl_log;
+	if ( _tl_log_dead ) return nullptr;
+
+	_tl_log = _thread_log_acquire();
+	if ( _tl_log == nullptr ) [[unlikely]]
+	{
+		_tl_log_dead = true;
+		return nullptr;
+	}
+	static thread_local _ThreadLogLease lease;
+	(void)lease;
+	return _tl_log;
+}
+
+[[nodiscard]] static MemoryTracer::BlockInfo* _extract_from_thread_logs( void const* ptr ) noexcept
+{
+	std::lock_guard lock_raii(_thread_logs_mutex);
+	for ( _ThreadLog* log=_thread_logs; log!=nullptr; log=log->next )
+	{
+		std::lock_guard lock_raii2(log->mutex);
+		if ( MemoryTracer::BlockInfo* block=log->extract(ptr); block!=nullptr ) return block;
+	}
+	return nullptr;
+}
+
+
+
+/*
+Sampling.  Each thread counts down the bytes it allocates, and records an allocation only when the
+count crosses zero; it then draws a new, exponentially distributed count (mean the sampling
+interval).  This is a Poisson process over bytes, so an allocation of size `s` is recorded with
+probability `1-exp(-s/interval)`.
+
+Recorded blocks are also counted in a small filter, indexed by pointer hash.  A deallocation whose
+slot is zero is certainly of an unrecorded block, so it can return immediately---which, when
+sampling, is nearly all of them.  Counters saturate (and then stay "maybe") rather than wrap.
+*/
+struct _Sampler final
+{
+	std::int64_t bytes_until_sample = 0;
+	std::uint64_t rng = 0; //Zero until seeded
+};
+static thread_local _Sampler _tl_sampler;
+
+//Uniform on (0,1], from xorshift64*
+[[nodiscard]] static double _sampler_uniform( _Sampler* sampler ) noexcept
+{
+	if ( sampler->rng == 0 ) [[unlikely]]
+	{
+		sampler->rng = 0x9E3779B97F4A7C15ull ^
+			static_cast<std::uint64_t>( std::hash<std::thread::id>()(std::this_thread::get_id()) ) ^
+			static_cast<std::uint64_t>( std::bit_cast<uintptr_t>(sampler) );
+		if ( sampler->rng == 0 ) sampler->rng=1;
+	}
+	sampler->rng ^= sampler->rng >> 12;
+	sampler->rng ^= sampler->rng << 25;
+	sampler->rng ^= sampler->rng >> 27;
+	std::uint64_t bits = sampler->rng * 0x2545F4914F6CDD1Dull;
+	return ( static_cast<double>(bits>>11) + 1.0 ) * 0x1.0p-53;
+}
+//Whether to record an allocation of the given size, and if so with what weight.
+[[nodiscard]] static bool _sample( std::size_t interval, std::size_t size, float* weight ) noexcept
+{
+	_Sampler* sampler = &_tl_sampler;
+	sampler->bytes_until_sample -= static_cast<std::int64_t>(size);
+	if ( sampler->bytes_until_sample > 0 ) [[likely]] return false;
+
+	bool first = sampler->rng == 0;
+	double mean = static_cast<double>(interval);
+	sampler->bytes_until_sample = static_cast<std::int64_t>( -std::log(_sampler_uniform(sampler)) * mean ) + 1;
+	if ( first ) [[unlikely]] return _sample( interval, size, weight ); //Wasn't really counting yet
+
+	*weight = static_cast<float>( 1.0 / -std::expm1( -static_cast<double>(size)/mean ) );
+	return true;
+}
+
+static constexpr unsigned _filter_bits = 20;
+static std::atomic<std::uint8_t> _recorded_filter[ std::size_t(1) << _filter_bits ];
+[[nodiscard]] static std::atomic<std::uint8_t>& _filter_slot( void const* ptr ) noexcept
+{
+	std::uint64_t hash = static_cast<std::uint64_t>( std::bit_cast<uintptr_t>(ptr) >> 4 );
+	return _recorded_filter[ (hash*0x9E3779B97F4A7C15ull) >> (64-_filter_bits) ];
+}
+static void _filter_add   ( void const* ptr ) noexcept
+{
+	std::atomic<std::uint8_t>& slot = _filter_slot(ptr);
+	std::uint8_t value = slot.load(std::memory_order_relaxed);
+	while ( value!=0xFF && !slot.compare_exchange_weak( value,value+1, std::memory_order_relaxed ) ) {}
+}
+static void _filter_remove( void const* ptr ) noexcept
+{
+	std::atomic<std::uint8_t>& slot = _filter_slot(ptr);
+	std::uint8_t value = slot.load(std::memory_order_relaxed);
+	while ( value!=0xFF && value!=0 && !slot.compare_exchange_weak( value,value-1, std::memory_order_relaxed ) ) {}
+}
+[[nodiscard]] static bool _filter_maybe_contains( void const* ptr ) noexcept
+{
+	return _filter_slot(ptr).load(std::memory_order_relaxed) != 0;
+}
+
+
+
+/*
+Live totals per allocation site, kept up to date as blocks are recorded and retired, so that a
+snapshot needn't look at the blocks themselves.  Indexed by stack id, in lazily allocated pages like
+the depot's.  The estimated totals (when sampling) are kept as the excess over the plain ones, so
+that without sampling they are never touched.
+*/
+struct _SiteLifetimes;
+struct _SiteTotals final
+{
+	std::atomic<std::int64_t> count;
+	std::atomic<std::int64_t> bytes;
+	std::atomic<double> extra_count;
+	std::atomic<double> extra_bytes;
+	//Allocations folded here instead of recorded, over the memory budget (cumulative)
+	std::atomic<std::uint64_t> folded_count;
+	std::atomic<std::uint64_t> folded_bytes;
+	//Blocks recorded here (cumulative), and the histogram of their lifetimes (see below)
+	std::atomic<std::uint64_t> allocations;
+	std::atomic<_SiteLifetimes*> lifetimes;
+};
+static std::atomic<_SiteTotals*> _site_totals_directory[ 1u << _depot_page_bits ];
+
+[[nodiscard]] static _SiteTotals* _site_totals( StackDepot::Id id, bool create ) noexcept
+{
+	std::atomic<_SiteTotals*>& root = _site_totals_directory[ id >> _depot_page_bits ];
+	_SiteTotals* page = root.load(std::memory_order_acquire);
+	if ( page == nullptr )
+	{
+		if ( !create ) return nullptr;
+		auto* fresh = static_cast<_SiteTotals*>( _overhead_calloc( 1u<<_depot_page_bits, sizeof(_SiteTotals) ) );
+		if ( fresh == nullptr ) [[unlikely]] return nullptr;
+		if ( root.compare_exchange_strong( page,fresh, std::memory_order_acq_rel ) ) page=fresh;
+		else _overhead_free( fresh, (1u<<_depot_page_bits)*sizeof(_SiteTotals) ); //Lost the race; `page` is now the winner's
+	}
+	return page + ( id & ((1u<<_depot_page_bits)-1) );
+}
+static void _site_totals_add( MemoryTracer::BlockInfo const& block, std::int64_t sign ) noexcept
+{
+	_SiteTotals* totals = _site_totals( block.stack_id, true );
+	if ( totals == nullptr ) [[unlikely]] return;
+	totals->count.fetch_add( sign                                     , std::memory_order_relaxed );
+	totals->bytes.fetch_add( sign*static_cast<std::int64_t>(block.size), std::memory_order_relaxed );
+	if ( block.weight != 1.0f ) [[unlikely]]
+	{
+		double extra = static_cast<double>(sign) * ( static_cast<double>(block.weight) - 1.0 );
+		totals->extra_count.fetch_add( extra                                   , std::memory_order_relaxed );
+		totals->extra_bytes.fetch_add( extra*static_cast<double>(block.size), std::memory_order_relaxed );
+	}
+}
+
+/*
+Allocation churn.  Recorded blocks are stamped with the steady clock, which is cheap next to
+recording them at all (and, unlike the TSC, needs no calibration to report in real time), and a
+freed block's lifetime is counted in a log-scale histogram of its site.  Most sites never free
+anything, so their histograms are allocated when their first block is freed.
+*/
+struct _SiteLifetimes final
+{
+	std::atomic<std::uint64_t> buckets[ MemoryTracer::ChurnSite::lifetime_buckets ];
+};
+static std::atomic<std::uint64_t> _churn_start_ns = 0; //When the tracer was created
+
+[[nodiscard]] static std::uint64_t _timestamp_ns() noexcept
+{
+	return static_cast<std::uint64_t>( std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()
+	).count() );
+}
+[[nodiscard]] static std::size_t _lifetime_bucket( std::uint64_t ns ) noexcept
+{
+	//Bucket 0 is under 2⁶ ns; after that, one bucket per power of two
+	auto width = static_cast<std::size_t>( std::bit_width(ns) );
+	if ( width <= 6 ) return 0;
+	return std::min( width-6, MemoryTracer::ChurnSite::lifetime_buckets-1 );
+}
+static void _churn_alloc( MemoryTracer::BlockInfo* block ) noexcept
+{
+	block->timestamp = _timestamp_ns();
+	_SiteTotals* totals = _site_totals( block->stack_id, true );
+	if ( totals == nullptr ) [[unlikely]] return;
+	totals->allocations.fetch_add( 1, std::memory_order_relaxed );
+}
+static void _churn_free( MemoryTracer::BlockInfo const& block ) noexcept
+{
+	std::uint64_t now = _timestamp_ns();
+	_SiteTotals* totals = _site_totals( block.stack_id, true );
+	if ( totals == nullptr ) [[unlikely]] return;
+
+	_SiteLifetimes* lifetimes = totals->lifetimes.load(std::memory_order_acquire);
+	if ( lifetimes == nullptr ) [[unlikely]]
+	{
+		auto* fresh = static_cast<_SiteLifetimes*>( _overhead_calloc( 1, sizeof(_SiteLifetimes) ) );
+		if ( fresh == nullptr ) [[unlikely]] return;
+		if ( totals->lifetimes.compare_exchange_strong( lifetimes,fresh, std::memory_order_acq_rel ) ) lifetimes=fresh;
+		else _overhead_free( fresh, sizeof(_SiteLifetimes) ); //Lost the race
+	}
+	std::uint64_t lifetime = now>block.timestamp ? now-block.timestamp : 0;
+	lifetimes->buckets[ _lifetime_bucket(lifetime) ].fetch_add( 1, std::memory_order_relaxed );
+}
+
+
+
+/*
+Background symbolization.  A low-priority thread periodically looks for allocation sites that have
+had live blocks for two passes in a row (which is where leaks will come from), and symbolizes and
+prettifies their frames into a shared cache.  The report at exit then starts from that cache, so it
+is mostly string concatenation.  The slow part is done outside the lock, so a thread looking
+something up waits at most for one insertion.
+*/
+static std::atomic<_Symbolizer*> _shared_symbolizer = nullptr; //Never destroyed (still used at exit)
+static std::thread* _symbolizer_thread = nullptr;
+static std::atomic<bool> _symbolizer_stop = false;
+#ifdef __clang__
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wexit-time-destructors"
+	#pragma clang diagnostic ignored "-Wglobal-constructors"
+#endif
+static std::mutex _symbolizer_thread_mutex; //Guards starting and stopping
+static std::condition_variable _symbolizer_wake;
+#ifdef __clang__
+	#pragma clang diagnostic pop
+#endif
+
+//The shared symbolizer, created on first use.  Caller must be internal.
+[[nodiscard]] static _Symbolizer& _get_shared_symbolizer()
+{
+	_Symbolizer* symbolizer = _shared_symbolizer.load(std::memory_order_acquire);
+	if ( symbolizer != nullptr ) [[likely]] return *symbolizer;
+
+	std::lock_guard lock_raii(_shared_symbolizer_mutex);
+	symbolizer = _shared_symbolizer.load(std::memory_order_relaxed);
+	if ( symbolizer == nullptr )
+	{
+		symbolizer = new _Symbolizer;
+		_shared_symbolizer.store( symbolizer, std::memory_order_release );
+	}
+	return *symbolizer;
+}
+
+static void _lower_this_thread_priority() noexcept
+{
+	#if   defined _WIN32
+		SetThreadPriority( GetCurrentThread(), THREAD_PRIORITY_LOWEST );
+	#elif defined __linux__
+		sched_param param = {};
+		pthread_setschedparam( pthread_self(), SCHED_IDLE, &param );
+	#else
+		sched_param param = {};
+		param.sched_priority = sched_get_priority_min(SCHED_OTHER);
+		pthread_setschedparam( pthread_self(), SCHED_OTHER, &param );
+	#endif
+}
+
+static void _symbolizer_main( std::uint32_t interval_ms )
+{
+	//Internal for the thread's whole life (never reset), since the thread's state is freed by this
+	//	thread after this returns, and it was allocated internally (see below), so never recorded.
+	_tl_internal = true;
+	_lower_this_thread_priority();
+	_Symbolizer& symbolizer = _get_shared_symbolizer();
+
+	//Per stack id: 0 not live, 1 live for one pass, 2 long-lived, 3 cached
+	std::vector<std::uint8_t> states;
+	std::vector<void*> frames;
+
+	std::unique_lock lock_raii(_symbolizer_thread_mutex);
+	while ( !_symbolizer_wake.wait_for(
+		lock_raii, std::chrono::milliseconds(interval_ms),
+		[]() { return _symbolizer_stop.load(std::memory_order_relaxed); }
+	) ) {
+		lock_raii.unlock();
+
+		std::size_t count = StackDepot::size();
+		states.resize( count+1, 0 );
+		for ( std::size_t id=1; id<=count; ++id )
+		{
+			if ( _symbolizer_stop.load(std::memory_order_relaxed) ) [[unlikely]] break;
+
+			_SiteTotals* totals = _site_totals( static_cast<StackDepot::Id>(id), false );
+			if ( totals==nullptr || totals->count.load(std::memory_order_relaxed)<=0 )
+			{
+				states[id] = 0;
+				continue;
+			}
+			if ( states[id] < 2 ) ++states[id];
+			if ( states[id] != 2 ) continue;
+
+			std::span< void* const > trace = StackDepot::get( static_cast<StackDepot::Id>(id) );
+			frames.clear();
+			{
+				std::lock_guard symbolizer_lock_raii(_shared_symbolizer_mutex);
+				for ( void* frame : trace )
+				{
+					if ( !symbolizer.is_cached(frame) ) frames.push_back(frame);
+				}
+			}
+			for ( void* frame : frames )
+			{
+				_Symbolizer::Frame symbolized = symbolizer.make_frame(frame);
+				std::lock_guard symbolizer_lock_raii(_shared_symbolizer_mutex);
+				symbolizer.add( frame, std::move(symbolized) );
+			}
+			states[id] = 3;
+		}
+
+		lock_raii.lock();
+	}
+}
+
+void MemoryTracerBase::start_background_symbolizer( std::uint32_t interval_ms/*=1000*/ ) noexcept
+{
+	InternalScope internal;
+	std::lock_guard lock_raii(_symbolizer_thread_mutex);
+	if ( _symbolizer_thread != nullptr ) return;
+
+	_symbolizer_stop.store( false, std::memory_order_relaxed );
+	try
+	{
+		_symbolizer_thread = new std::thread( _symbolizer_main, interval_ms );
+	}
+	catch ( std::exception const& ) {} //(E.g., can't create threads.)  Just don't symbolize early.
+}
+void MemoryTracerBase::stop_background_symbolizer() noexcept
+{
+	InternalScope internal;
+	std::thread* thread;
+	{
+		std::lock_guard lock_raii(_symbolizer_thread_mutex);
+		thread = _symbolizer_thread;
+		_symbolizer_thread = nullptr;
+		_symbolizer_stop.store( true, std::memory_order_relaxed );
+	}
+	if ( thread == nullptr ) return;
+	_symbolizer_wake.notify_all();
+	thread->join();
+	delete thread;
+}
+
+
+
+/*
+Ignore verdicts, made at allocation time.  An allocation made directly from one of
+`TINYLEAKCHECK_IGNORE_FUNCS` would just be dropped from the report at exit, so it isn't recorded in
+the first place (no stack trace, no record).  The verdict is decided once per call site (by
+symbolizing it into the shared cache), and kept in a fixed-size lock-free table: open addressing,
+with a short linear probe.  While a verdict is being decided, or if the table is full around a call
+site, its allocations are recorded as before.  Stacks that pass through an ignored function further
+up are still filtered out at exit.
+
+Only looking a verdict up is lock-free.  Deciding one, the first time a call site allocates, means
+symbolizing it (inside the allocation, which is slow) and caching the frame in the shared
+symbolizer (under its mutex).  That cost is paid once per call site, not per allocation.
+*/
+struct _IgnoreVerdict final
+{
+	std::atomic<uintptr_t> call_site; //(Zero if the slot is free)
+	std::atomic<std::uint8_t> verdict; //(Zero while pending)
+};
+static constexpr std::size_t _ignore_verdicts_bits = 12;
+static constexpr std::size_t _ignore_verdicts_probe = 16;
+static constexpr std::uint8_t _verdict_keep=1, _verdict_ignore=2;
+static _IgnoreVerdict _ignore_verdicts[ 1u << _ignore_verdicts_bits ];
+static std::atomic<std::int8_t> _ignore_at_alloc = -1; //Whether there is anything to ignore (or -1, unknown)
+
+[[nodiscard]] static bool _ignored_call_site( void const* call_site )
+{
+	#ifdef TINYLEAKCHECK_NO_IGNORE_AT_ALLOC
+		(void)call_site;
+		return false;
+	#else
+		std::int8_t enabled = _ignore_at_alloc.load(std::memory_order_relaxed);
+		if ( enabled < 0 ) [[unlikely]]
+		{
+			enabled = _get_shared_symbolizer().has_ignores() ? 1 : 0;
+			_ignore_at_alloc.store( enabled, std::memory_order_relaxed );
+		}
+		if ( enabled == 0 ) return false;
+
+		uintptr_t address = std::bit_cast<uintptr_t>(call_site);
+		std::size_t hash = static_cast<std::size_t>(
+			( static_cast<std::uint64_t>(address) * 0x9E3779B97F4A7C15ull ) >> ( 64 - _ignore_verdicts_bits )
+		);
+		for ( std::size_t probe=0; probe<_ignore_verdicts_probe; ++probe )
+		{
+			_IgnoreVerdict& slot = _ignore_verdicts[ (hash+probe) & ((1u<<_ignore_verdicts_bits)-1) ];
+			uintptr_t occupant = slot.call_site.load(std::memory_order_acquire);
+			if ( occupant == 0 )
+			{
+				if ( !slot.call_site.compare_exchange_strong( occupant,address, std::memory_order_acq_rel ) )
+				{
+					if ( occupant != address ) continue; //Lost the slot to another call site
+				}
+				else
+				{
+					//Claimed; decide
+					bool ignored = _get_shared_symbolizer().shared_frame(call_site).ignored;
+					slot.verdict.store( ignored ? _verdict_ignore : _verdict_keep, std::memory_order_release );
+					return ignored;
+				}
+			}
+			if ( occupant == address ) [[likely]]
+			{
+				return slot.verdict.load(std::memory_order_acquire) == _verdict_ignore;
+			}
+		}
+		return false;
+	#endif
+}
+
+
+
+/*
+Statistics.  Each thread counts its own allocations and deallocations, in a cache line or so of its
+own, and a read sums over all threads (plus the totals of threads that have exited).  Counters are
+only ever written by their own thread, so they're plain loads and stores (of atomics, so that
+readers may look at any time), with no read-modify-writes on the hot path.
+
+The peak can't be found by summing per-thread values, so each thread also accumulates its change in
+live bytes, and adds it to a shared total (updating the peak) only when it exceeds a threshold.  The
+peak may therefore be underestimated by up to the threshold per thread.
+*/
+static constexpr std::int64_t _stats_publish_threshold = 64 * 1024;
+struct alignas(64) _ThreadStats final
+{
+	std::atomic<std::uint64_t> alloc_count, free_count, free_unknown_count;
+	std::atomic<std::uint64_t> alloc_bytes, free_bytes;
+	std::atomic<std::uint64_t> histogram[ MemoryTracer::Stats::histogram_size ];
+	std::int64_t unpublished = 0; //Change in live bytes not yet added to `_stats_live`
+
+	_ThreadStats* prev = nullptr;
+	_ThreadStats* next = nullptr;
+
+	_ThreadStats() noexcept;
+	~_ThreadStats() noexcept;
+};
+#ifdef __clang__
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wexit-time-destructors"
+	#pragma clang diagnostic ignored "-Wglobal-constructors"
+#endif
+static std::mutex _stats_mutex;
+#ifdef __clang__
+	#pragma clang diagnostic pop
+#endif
+static _ThreadStats* _stats_threads = nullptr;
+static MemoryTracer::Stats _stats_exited; //Guarded by `_stats_mutex`
+static std::atomic<std::int64_t> _stats_live = 0;
+static std::atomic<std::int64_t> _stats_peak = 0;
+static thread_local bool _tl_stats_dead = false;
+
+static void _stats_publish( std::int64_t delta ) noexcept
+{
+	std::int64_t live = _stats_live.fetch_add( delta, std::memory_order_relaxed ) + delta;
+	std::int64_t peak = _stats_peak.load(std::memory_order_relaxed);
+	while ( live>peak && !_stats_peak.compare_exchange_weak( peak,live, std::memory_order_relaxed ) ) {}
+}
+
+_ThreadStats::_ThreadStats() noexcept
+{
+	std::lock_guard lock_raii(_stats_mutex);
+	next = _stats_threads;
+	if ( next != nullptr ) next->prev = this;
+	_stats_threads = this;
+}
+_ThreadStats::~_ThreadStats() noexcept
+{
+	_tl_stats_dead = true;
+	_stats_publish(unpublished);
+
+	std::lock_guard lock_raii(_stats_mutex);
+	_stats_exited.alloc_count        += alloc_count       .load(std::memory_order_relaxed);
+	_stats_exited.free_count         += free_count        .load(std::memory_order_relaxed);
+	_stats_exited.free_unknown_count += free_unknown_count.load(std::memory_order_relaxed);
+	_stats_exited.alloc_bytes        += alloc_bytes       .load(std::memory_order_relaxed);
+	_stats_exited.free_bytes         += free_bytes        .load(std::memory_order_relaxed);
+	for ( std::size_t k=0; k<MemoryTracer::Stats::histogram_size; ++k )
+	{
+		_stats_exited.histogram[k] += histogram[k].load(std::memory_order_relaxed);
+	}
+
+	if ( prev != nullptr ) prev->next = next;
+	else                   _stats_threads = next;
+	if ( next != nullptr ) next->prev = prev;
+}
+
+//Increments a counter that only this thread writes
+inline static void _stats_bump( std::atomic<std::uint64_t>* counter, std::uint64_t value ) noexcept
+{
+	counter->store( counter->load(std::memory_order_relaxed)+value, std::memory_order_relaxed );
+}
+
+void MemoryTracerBase::_count_alloc( size_t size ) noexcept
+{
+	std::size_t bin = static_cast<std::size_t>( std::bit_width(size) );
+	if ( _tl_stats_dead ) [[unlikely]]
+	{
+		std::lock_guard lock_raii(_stats_mutex);
+		++_stats_exited.alloc_count;
+		_stats_exited.alloc_bytes += size;
+		++_stats_exited.histogram[bin];
+		_stats_publish( static_cast<std::int64_t>(size) );
+		return;
+	}
+	static thread_local _ThreadStats stats;
+
+	_stats_bump( &stats.alloc_count, 1 );
+	_stats_bump( &stats.alloc_bytes, size );
+	_stats_bump( stats.histogram+bin, 1 );
+
+	stats.unpublished += static_cast<std::int64_t>(size);
+	if ( stats.unpublished > _stats_publish_threshold ) [[unlikely]]
+	{
+		_stats_publish(stats.unpublished);
+		stats.unpublished = 0;
+	}
+}
+void MemoryTracerBase::_count_dealloc( size_t size ) noexcept
+{
+	bool known = size != unknown_size;
+	if ( _tl_stats_dead ) [[unlikely]]
+	{
+		std::lock_guard lock_raii(_stats_mutex);
+		++_stats_exited.free_count;
+		if ( known ) _stats_exited.free_bytes += size;
+		else         ++_stats_exited.free_unknown_count;
+		if ( known ) _stats_publish( -static_cast<std::int64_t>(size) );
+		return;
+	}
+	static thread_local _ThreadStats stats;
+
+	_stats_bump( &stats.free_count, 1 );
+	if ( !known ) [[unlikely]]
+	{
+		_stats_bump( &stats.free_unknown_count, 1 );
+		return;
+	}
+	_stats_bump( &stats.free_bytes, size );
+
+	stats.unpublished -= static_cast<std::int64_t>(size);
+	if ( stats.unpublished < -_stats_publish_threshold ) [[unlikely]]
+	{
+		_stats_publish(stats.unpublished);
+		stats.unpublished = 0;
+	}
+}
+
+[[nodiscard]] MemoryTracerBase::Stats MemoryTracerBase::get_stats() noexcept
+{
+	std::lock_guard lock_raii(_stats_mutex);
+	Stats result = _stats_exited;
+	for ( _ThreadStats const* stats=_stats_threads; stats!=nullptr; stats=stats->next )
+	{
+		result.alloc_count        += stats->alloc_count       .load(std::memory_order_relaxed);
+		result.free_count         += stats->free_count        .load(std::memory_order_relaxed);
+		result.free_unknown_count += stats->free_unknown_count.load(std::memory_order_relaxed);
+		result.alloc_bytes        += stats->alloc_bytes       .load(std::memory_order_relaxed);
+		result.free_bytes         += stats->free_bytes        .load(std::memory_order_relaxed);
+		for ( std::size_t k=0; k<Stats::histogram_size; ++k )
+		{
+			result.histogram[k] += stats->histogram[k].load(std::memory_order_relaxed);
+		}
+	}
+	result.live_bytes = static_cast<std::int64_t>( result.alloc_bytes - result.free_bytes );
+	result.peak_bytes = std::max( _stats_peak.load(std::memory_order_relaxed), result.live_bytes );
+	result.overhead_bytes = _overhead_bytes.load(std::memory_order_relaxed);
+	return result;
+}
+
+
+
+/*
+Event stream.  Each thread lazily takes a ring file of its own the first time it has an event to
+write, and from then on appends to it with plain stores: no locks, no allocation, no symbolization.
+When the thread exits, its ring goes onto a free list, and the next thread to need one continues it
+(records carry timestamps, so the threads' events still merge in order), so that programs with
+short-lived threads don't create a file per thread.  Past `_events_max_rings`, threads share ring
+zero, under a mutex, as do threads that can't have a ring of their own (e.g. while one is being
+created, which would recurse, or after theirs was given back, during thread exit).  Rings are never
+unmapped; the kernel writes the pages back to the files.
+*/
+struct _EventRing final
+{
+	EventStream::FileHeader* header;
+	EventStream::Record* records;
+	std::uint32_t thread_index;
+	_EventRing* next_free; //While on `_events_free_rings`
+};
+static constexpr std::uint32_t _events_max_rings = 64; //(Not counting ring zero)
+static std::atomic<bool> _events_open = false;
+static char _events_directory[ 4096 ];
+static std::uint64_t _events_capacity = 0;
+static std::atomic<std::uint32_t> _events_next_thread = 1;
+static thread_local _EventRing* _tl_event_ring = nullptr;
+static thread_local bool _tl_event_busy = false;
+static thread_local bool _tl_event_shared = false; //If so, this thread only uses ring zero
+#ifdef __clang__
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wexit-time-destructors"
+	#pragma clang diagnostic ignored "-Wglobal-constructors"
+#endif
+static std::mutex _events_shared_mutex;
+#ifdef __clang__
+	#pragma clang diagnostic pop
+#endif
+static _EventRing* _events_shared_ring = nullptr;
+static _EventRing* _events_free_rings = nullptr; //Guarded by `_events_shared_mutex`, also
+
+#ifndef _WIN32
+//Copies "/proc/self/maps" next to the rings, so the analyzer can map addresses back to binaries
+static void _events_write_maps() noexcept
+{
+	#ifdef __linux__
+		char path[ sizeof(_events_directory) + 64 ];
+		snprintf( path,sizeof(path), "%s/tinyleakcheck.%u.maps", _events_directory, unsigned(getpid()) );
+		FILE* out = fopen( path, "w" );
+		if ( out == nullptr ) return;
+		if ( FILE* maps=fopen("/proc/self/maps","r"); maps!=nullptr )
+		{
+			char chunk[ 4096 ];
+			for ( std::size_t read; (read=fread(chunk,1,sizeof(chunk),maps))>0; ) fwrite( chunk,1,read, out );
+			fclose(maps);
+		}
+		fclose(out);
+	#endif
+}
+
+//Creates and maps a new ring file.  Allocates nothing on the traced heap.
+[[nodiscard]] static _EventRing* _events_create_ring( std::uint32_t thread_index ) noexcept
+{
+	char path[ sizeof(_events_directory) + 64 ];
+	snprintf( path,sizeof(path), "%s/tinyleakcheck.%u.%u.events",
+		_events_directory, unsigned(getpid()), unsigned(thread_index)
+	);
+
+	std::size_t bytes = sizeof(EventStream::FileHeader) + _events_capacity*sizeof(EventStream::Record);
+	int fd = open( path, O_RDWR|O_CREAT|O_TRUNC|O_CLOEXEC, 0644 );
+	if ( fd < 0 ) return nullptr;
+	if ( ftruncate( fd, static_cast<off_t>(bytes) ) != 0 )
+	{
+		close(fd);
+		return nullptr;
+	}
+	void* mapped = mmap( nullptr, bytes, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0 );
+	close(fd);
+	if ( mapped == MAP_FAILED ) return nullptr;
+
+	auto* ring = static_cast<_EventRing*>( _overhead_malloc(sizeof(_EventRing)) );
+	if ( ring == nullptr )
+	{
+		munmap( mapped, bytes );
+		return nullptr;
+	}
+
+	//(The file starts out zeroed, so only the nonzero fields need writing.)
+	auto* header = static_cast<EventStream::FileHeader*>(mapped);
+	memcpy( header->magic, EventStream::magic, sizeof(header->magic) );
+	header->version      = EventStream::version;
+	header->record_size  = sizeof(EventStream::Record);
+	header->capacity     = _events_capacity;
+	header->pid          = static_cast<std::uint32_t>( getpid() );
+	header->thread_index = thread_index;
+
+	ring->header       = header;
+	ring->records      = reinterpret_cast<EventStream::Record*>( header + 1 );
+	ring->thread_index = thread_index;
+	ring->next_free    = nullptr;
+	return ring;
+}
+
+//Gives the thread's ring back when it exits.
+struct _EventRingLease final
+{
+	~_EventRingLease() noexcept
+	{
+		_tl_event_shared = true; //(Anything freed later in thread exit goes to ring zero)
+		_EventRing* ring = _tl_event_ring;
+		_tl_event_ring = nullptr;
+		if ( ring == nullptr ) return;
+
+		std::lock_guard lock_raii(_events_shared_mutex);
+		ring->next_free = _events_free_rings;
+		_events_free_rings = ring;
+	}
+};
+//A free ring, else a new one, or `nullptr` if there can't be any more.
+[[nodiscard]] static _EventRing* _events_acquire_ring() noexcept
+{
+	{
+		std::lock_guard lock_raii(_events_shared_mutex);
+		if ( _EventRing* ring=_events_free_rings; ring!=nullptr )
+		{
+			_events_free_rings = ring->next_free;
+			ring->next_free = nullptr;
+			return ring;
+		}
+	}
+	if ( _events_next_thread.load(std::memory_order_relaxed) > _events_max_rings ) return nullptr;
+	std::uint32_t index = _events_next_thread.fetch_add( 1, std::memory_order_relaxed );
+	if ( index > _events_max_rings ) return nullptr;
+	return _events_create_ring(index);
+}
+#endif
+
+bool MemoryTracerBase::open_event_stream( char const* directory, std::size_t ring_records/*=1<<18*/ ) noexcept
+{
+	#ifdef _WIN32
+		(void)directory; (void)ring_records;
+		return false;
+	#else
+		if ( _events_open.load(std::memory_order_acquire) ) return false; //Already open
+		if ( strlen(directory)>=sizeof(_events_directory) || ring_records==0 ) return false;
+
+		snprintf( _events_directory,sizeof(_events_directory), "%s", directory );
+		_events_capacity = ring_records;
+		_events_shared_ring = _events_create_ring(0);
+		if ( _events_shared_ring == nullptr ) return false;
+		_events_write_maps();
+
+		_events_open.store( true, std::memory_order_release );
+		return true;
+	#endif
+}
+void MemoryTracerBase::close_event_stream() noexcept
+{
+	//Stops writing; the rings stay mapped (other threads may be mid-write).
+	if ( !_events_open.exchange( false, std::memory_order_acq_rel ) ) return;
+	#ifndef _WIN32
+		_events_write_maps(); //Catch libraries loaded since opening
+	#endif
+}
+
+static void _events_write(
+	EventStream::Op op, void const* ptr, std::size_t size, std::size_t alignment,
+	void const* call_site
+) noexcept {
+	#ifdef _WIN32
+		(void)op; (void)ptr; (void)size; (void)alignment; (void)call_site;
+	#else
+		//Not reentrant: capturing the stack, or creating the ring, might allocate.  The tracer's own
+		//	allocations are not the program's, so they are left out too.
+		if ( _tl_event_busy || _tl_internal ) [[unlikely]] return;
+		_tl_event_busy = true;
+
+		_EventRing* ring = _tl_event_ring;
+		if ( ring==nullptr && !_tl_event_shared ) [[unlikely]]
+		{
+			ring = _events_acquire_ring();
+			if ( ring != nullptr )
+			{
+				static thread_local _EventRingLease lease;
+				(void)lease;
+				_tl_event_ring = ring;
+			}
+			else _tl_event_shared = true;
+		}
+
+		EventStream::Record record;
+		record.timestamp = _timestamp_ns();
+		record.ptr       = static_cast<std::uint64_t>( std::bit_cast<uintptr_t>(ptr) );
+		record.size      = static_cast<std::uint64_t>(size);
+		record.alignment = static_cast<std::uint32_t>(alignment);
+		record.op        = op;
+		record.frame_count = 0;
+		memset( record.reserved, 0, sizeof(record.reserved) );
+		if ( call_site != nullptr )
+		{
+			StackTrace trace = StackTrace::current(call_site);
+			for ( void* frame : trace )
+			{
+				if ( record.frame_count == EventStream::max_frames ) break;
+				record.frames[ record.frame_count++ ] = static_cast<std::uint64_t>( std::bit_cast<uintptr_t>(frame) );
+			}
+		}
+
+		auto append = [&record]( _EventRing* into )
+		{
+			record.thread_index = into->thread_index;
+			std::uint64_t index = into->header->written.load(std::memory_order_relaxed);
+			memcpy( into->records+index%_events_capacity, &record, sizeof(record) );
+			into->header->written.store( index+1, std::memory_order_release );
+		};
+		if ( ring != nullptr ) [[likely]] append(ring);
+		else
+		{
+			std::lock_guard lock_raii(_events_shared_mutex);
+			append(_events_shared_ring);
+		}
+
+		_tl_event_busy = false;
+	#endif
+}
+
+
+
+template< class Tracer >
+static void _default_callback_print_site(
+	Tracer const& /*tracer*/, MemoryTracerBase::Site const& site
+) {
+	site.basic_print();
+}
+template< class Tracer >
+static void _default_callback_post_alloc (
+	Tracer const& /*tracer*/, void* /*ptr*/, size_t /*alignment*/, size_t /*size*/
+) {}
+template< class Tracer >
+static void _default_callback_pre_dealloc(
+	Tracer const& /*tracer*/, void* /*ptr*/, size_t /*alignment*/
+) {}
+//(Preloaded into a program as shipped, this only reports; the program exits as it would have.)
+#ifdef TINYLEAKCHECK_PRELOAD
+	#define TINYLEAKCHECK_REPORT_NORETURN
+#else
+	#define TINYLEAKCHECK_REPORT_NORETURN [[noreturn]]
+#endif
+template< class Tracer >
+TINYLEAKCHECK_REPORT_NORETURN static void _default_callback_leaks_detected( Tracer const& tracer )
+{
+	std::vector<MemoryTracerBase::Site> sites = tracer.collect_sites();
+	if ( tracer._sampled_ever.load(std::memory_order_relaxed) )
+	{
+		double count=0.0, bytes=0.0;
+		for ( MemoryTracerBase::Site const& site : sites )
+		{
+			count += site.estimated_count;
+			bytes += site.estimated_bytes;
+		}
+		fprintf( stderr,
+			"Leaks detected!  (Sampled; estimated %.0f blocks, %.0f bytes in total.)\n", count,bytes
+		);
+	}
+	else fprintf( stderr, "Leaks detected!\n" );
+	if ( tracer.callbacks.print_site == _default_callback_print_site<Tracer> ) [[likely]]
+	{
+		//Format all the sites in parallel, then write them out in order, in large chunks.  The
+		//	threads share a symbolizer, only reading its cache, so first symbolize whatever frames
+		//	of these sites aren't in it.  (Most were, when deciding which stacks to ignore, but
+		//	other threads may have published blocks since.)
+		std::optional<_Symbolizer> local;
+		_Symbolizer* symbolizer = _symbolizer_of_report;
+		if ( symbolizer == nullptr ) symbolizer=&local.emplace();
+		{
+			std::vector<StackDepot::Id> stack_ids;
+			stack_ids.reserve( sites.size() );
+			for ( MemoryTracerBase::Site const& site : sites ) stack_ids.push_back( site.stack_id );
+			symbolizer->prefetch( stack_ids );
+		}
+
+		std::vector<std::string> strs( sites.size() );
+		_parallel_for( sites.size(), 256, [&]( std::size_t begin, std::size_t end )
+		{
+			_tl_shared_symbolizer = symbolizer;
+			for ( std::size_t k=begin; k<end; ++k ) sites[k].basic_format( &strs[k] );
+			_tl_shared_symbolizer = nullptr;
+		} );
+
+		std::string buffer;
+		for ( std::string const& str : strs )
+		{
+			buffer += str;
+			if ( buffer.size() >= (1u<<20) )
+			{
+				fwrite( buffer.data(), 1,buffer.size(), stderr );
+				buffer.clear();
+			}
+		}
+		fwrite( buffer.data(), 1,buffer.size(), stderr );
+	}
+	else
+	{
+		for ( MemoryTracerBase::Site const& site : sites )
+		{
+			tracer.callbacks.print_site( tracer, site );
+		}
+	}
+
+	#ifdef TINYLEAKCHECK_PRELOAD
+		fflush(stderr);
+	#else
+		/*
+		Welcome, humble programmer!  I have summoned you here today to help you debug your code.  If
+		you are reading this, you probably have been trapped here by your debugger.  Fear not!  The
+		details of the memory leaks in your code have (by default) been dumped directly into
+		`stderr`!  Fix it!
+		*/
+		#ifndef NDEBUG
+			#if   defined __clang__ || defined __GNUC__
+				__builtin_trap();
+			#elif defined _MSC_VER
+				__debugbreak();
+			#endif
+		#endif
+
+		#ifdef __clang__
+			#pragma clang diagnostic push
+			#pragma clang diagnostic ignored "-Wunreachable-code"
+		#endif
+		std::abort();
+		#ifdef __clang__
+			#pragma clang diagnostic pop
+		#endif
+	#endif
+}
+#undef TINYLEAKCHECK_REPORT_NORETURN
+
+/*
+Memory budget.  The degradation follows from the overhead whenever it's asked for, so there's no
+state to keep in step with the budget.  Folded allocations are counted with the live totals of
+their call site's one-frame stack; interning those is the only memory a folded allocation can cost
+(once per call site), so the overhead stays within the budget plus that.
+*/
+static std::atomic<bool> _folded_ever = false;
+
+void MemoryTracerBase::set_memory_budget( std::size_t bytes ) noexcept
+{
+	_memory_budget.store( bytes, std::memory_order_relaxed );
+}
+[[nodiscard]] MemoryTracerBase::Degradation MemoryTracerBase::get_degradation() const noexcept
+{
+	std::size_t budget = get_memory_budget();
+	if ( budget == 0 ) [[likely]] return Degradation::none;
+
+	std::size_t overhead = get_overhead_bytes();
+	if ( overhead >= budget            ) return Degradation::folded;
+	if ( overhead >= budget - budget/8 ) return Degradation::call_sites_only;
+	return Degradation::none;
+}
+[[nodiscard]] std::size_t MemoryTracerBase::get_overhead_bytes() noexcept
+{
+	return _overhead_bytes.load(std::memory_order_relaxed);
+}
+static void _fold( void const* call_site, size_t size ) noexcept
+{
+	_SiteTotals* totals = _site_totals( StackDepot::intern(StackTrace::of_call_site(call_site)), true );
+	if ( totals == nullptr ) [[unlikely]] return;
+	totals->folded_count.fetch_add( 1   , std::memory_order_relaxed );
+	totals->folded_bytes.fetch_add( size, std::memory_order_relaxed );
+	if ( !_folded_ever.load(std::memory_order_relaxed) ) [[unlikely]]
+	{
+		_folded_ever.store( true, std::memory_order_relaxed );
+	}
+}
+
+MemoryTracerBase::MemoryTracerBase() :
+	_override(0),
+	#ifdef TINYLEAKCHECK_PRELOAD
+		_unrecorded_ever(true), //The loader and other libraries allocated before the tracer existed
+	#else
+		_unrecorded_ever(false),
+	#endif
+	_epoch(0),
+	_generation(1),
+	_sampling_interval(TINYLEAKCHECK_SAMPLING_INTERVAL),
+	_sampled_ever( TINYLEAKCHECK_SAMPLING_INTERVAL != 0 ),
+	_memory_budget(TINYLEAKCHECK_MEMORY_BUDGET)
+{
+	_churn_start_ns.store( _timestamp_ns(), std::memory_order_relaxed );
+
+	#ifdef TINYLEAKCHECK_BACKGROUND_SYMBOLIZER
+		start_background_symbolizer( TINYLEAKCHECK_BACKGROUND_SYMBOLIZER );
+	#endif
+
+	if ( char const* budget=getenv("TINYLEAKCHECK_MEMORY_BUDGET"); budget!=nullptr && *budget!='\0' )
+	{
+		set_memory_budget( static_cast<std::size_t>( strtoull( budget, nullptr, 10 ) ) );
+	}
+
+	if ( char const* directory=getenv("TINYLEAKCHECK_EVENT_STREAM"); directory!=nullptr && *directory!='\0' )
+	{
+		if ( !open_event_stream(directory) )
+		{
+			fprintf( stderr, "TinyLeakCheck: could not open event stream in \"%s\".\n", directory );
+		}
+	}
+}
+template< class Policy >
+BasicMemoryTracer<Policy>::BasicMemoryTracer()
+{
+	callbacks.print_site     = _default_callback_print_site    <BasicMemoryTracer>;
+	callbacks.post_alloc     = _default_callback_post_alloc    <BasicMemoryTracer>;
+	callbacks.pre_dealloc    = _default_callback_pre_dealloc   <BasicMemoryTracer>;
+	callbacks.leaks_detected = _default_callback_leaks_detected<BasicMemoryTracer>;
+}
+template< class Policy >
+BasicMemoryTracer<Policy>::~BasicMemoryTracer()
+{
+	stop_background_symbolizer();
+	flush();
+
+	#ifndef _WIN32
+		//The stream stays open (later deallocations still matter); just refresh the mappings
+		if ( _events_open.load(std::memory_order_acquire) ) _events_write_maps();
+	#endif
+
+	if ( char const* path=getenv("TINYLEAKCHECK_CHURN_REPORT"); path!=nullptr && *path!='\0' )
+	{
+		if ( strcmp(path,"-") == 0 ) write_churn_report(stderr);
+		else if ( FILE* file=fopen(path,"w"); file!=nullptr )
+		{
+			write_churn_report(file);
+			fclose(file);
+		}
+		else fprintf( stderr, "TinyLeakCheck: could not write churn report to \"%s\".\n", path );
+	}
+
+	if ( _folded_ever.load(std::memory_order_relaxed) ) [[unlikely]]
+	{
+		std::size_t count=0, bytes=0;
+		std::vector<Site> folded = collect_folded_sites();
+		for ( Site const& site : folded ) { count+=site.count; bytes+=site.bytes; }
+		fprintf( stderr,
+			"TinyLeakCheck: over its memory budget, %zu allocations (%zu bytes) from %zu call sites "
+			"were only counted, not recorded; any leaks among them can't be reported.\n",
+			count, bytes, folded.size()
+		);
+	}
+
+	if ( blocks.empty() ) [[likely]] return;
+
+	InternalScope internal;
+
+	//Shared by everything that symbolizes frames for this report.  This starts from the shared
+	//	symbolizer's cache (e.g., what the background symbolizer did), if there is one, but as a
+	//	copy: threads still allocating may be adding to that one (see `_ignored_call_site(⋯)`).
+	std::optional<_Symbolizer> local;
+	if ( _Symbolizer* shared=_shared_symbolizer.load(std::memory_order_acquire); shared!=nullptr )
+	{
+		std::lock_guard lock_raii(_shared_symbolizer_mutex);
+		local.emplace(*shared);
+	}
+	else local.emplace();
+	_Symbolizer& symbolizer = *local;
+	_tl_symbolizer = &symbolizer;
+	_symbolizer_of_report = &symbolizer;
+
+	//Final processing on all blocks, removing those which should be ignored.  This is decided once
+	//	per distinct stack, after symbolizing all their frames (in parallel).
+	_UntracedMap< StackDepot::Id, bool > keep_stack;
+	blocks.for_each( [&keep_stack]( BlockInfo const& block )
+	{
+		keep_stack.try_emplace( block.stack_id, true );
+	} );
+	{
+		std::vector<StackDepot::Id> stack_ids;
+		stack_ids.reserve( keep_stack.size() );
+		for ( auto const& iter : keep_stack ) stack_ids.push_back( iter.first );
+		symbolizer.prefetch( stack_ids );
+	}
+	for ( auto& iter : keep_stack ) iter.second=symbolizer.keep_stack( iter.first );
+	blocks.extract_if( [&]( BlockInfo* block )
+	{
+		auto [iter,inserted] = keep_stack.try_emplace( block->stack_id, true );
+		if ( inserted ) iter->second=symbolizer.keep_stack( block->stack_id ); //(Published since)
+		if ( iter->second ) [[unlikely]] return false;
+		_BlockPool::destroy(block);
+		return true;
+	} );
+
+	if ( blocks.empty() ) [[likely]]
+	{
+		_tl_symbolizer = nullptr;
+		_symbolizer_of_report = nullptr;
+		return;
+	}
+
+	//If there are still blocks, then memory leak!
+
+	callbacks.leaks_detected(*this);
+	_tl_symbolizer = nullptr;
+	_symbolizer_of_report = nullptr;
+
+	blocks.extract_if( []( BlockInfo* block )
+	{
+		_BlockPool::destroy(block);
+		return true;
+	} );
+}
+
+void MemoryTracerBase::set_override( Override record, Override with_stacktrace ) noexcept
+{
+	_override.store(
+		static_cast<std::uint8_t>( static_cast<unsigned>(record) | static_cast<unsigned>(with_stacktrace)<<2 ),
+		std::memory_order_relaxed
+	);
+}
+
+void MemoryTracerBase::set_sampling_interval( std::size_t bytes ) noexcept
+{
+	if ( bytes != 0 ) _sampled_ever.store( true, std::memory_order_relaxed );
+	_sampling_interval.store( bytes, std::memory_order_relaxed );
+}
+
+//Adds a new (or moved) record, to the calling thread's log if there are logs, else the registry.
+template< bool thread_logs >
+static void _insert_block( MemoryTracer::BlockRegistry* blocks, MemoryTracer::BlockInfo* block ) noexcept
+{
+	if constexpr ( thread_logs )
+	{
+		if ( _ThreadLog* log=_this_thread_log(); log!=nullptr ) [[likely]]
+		{
+			std::lock_guard lock_raii(log->mutex);
+			log->push(block);
+			return;
+		}
+	}
+	blocks->insert(block);
+}
+
+template< class Policy >
+TINYLEAKCHECK_NOINLINE void BasicMemoryTracer<Policy>::record_alloc(
+	void* ptr, size_t alignment, size_t size, void const* call_site/*=nullptr*/
+) {
+	if ( call_site == nullptr ) call_site=TINYLEAKCHECK_RETURN_ADDRESS();
+	(void)_record_alloc( ptr, alignment, size, call_site );
+}
+template< class Policy >
+[[nodiscard]] std::uint32_t BasicMemoryTracer<Policy>::_record_alloc(
+	void* ptr, size_t alignment, size_t size, void const* call_site
+) {
+	//(Checked before anything else, so that unrecorded allocations cost nearly nothing.)
+	if ( _tl_internal ) return 0;
+	if ( !is_recording() )
+	{
+		//Another thread may free this block while recording, which is then fine
+		if ( !_unrecorded_ever.load(std::memory_order_relaxed) ) [[unlikely]]
+		{
+			_unrecorded_ever.store( true, std::memory_order_relaxed );
+		}
+		return 0;
+	}
+
+	float weight = 1.0f;
+	if ( std::size_t interval=get_sampling_interval(); interval!=0 ) [[unlikely]]
+	{
+		if ( !_sample( interval, size, &weight ) ) [[likely]] return 0;
+	}
+
+	InternalScope internal;
+
+	if ( _ignored_call_site(call_site) ) [[unlikely]]
+	{
+		if ( !_unrecorded_ever.load(std::memory_order_relaxed) ) [[unlikely]]
+		{
+			_unrecorded_ever.store( true, std::memory_order_relaxed );
+		}
+		return 0;
+	}
+
+	bool with_stacktrace = is_recording_stacktraces();
+	bool call_site_only = false;
+	if constexpr ( Policy::stack_capture == StackCapture::call_site )
+	{
+		call_site_only  = with_stacktrace;
+		with_stacktrace = false;
+	}
+	if ( get_memory_budget() != 0 ) [[unlikely]]
+	{
+		Degradation degradation = get_degradation();
+		if ( degradation == Degradation::folded )
+		{
+			_fold( call_site, size );
+			if ( !_unrecorded_ever.load(std::memory_order_relaxed) ) [[unlikely]]
+			{
+				_unrecorded_ever.store( true, std::memory_order_relaxed );
+			}
+			return 0;
+		}
+		if ( degradation==Degradation::call_sites_only && with_stacktrace )
+		{
+			with_stacktrace = false;
+			call_site_only  = true;
+		}
+	}
+
+	BlockInfo* block = _BlockPool::create(
+		ptr, alignment, size, with_stacktrace, call_site
+	);
+	if ( block == nullptr ) [[unlikely]]
+	{
+		//Out of memory for the tracer itself.  The block goes unrecorded, as if ignored.
+		if ( !_unrecorded_ever.load(std::memory_order_relaxed) )
+		{
+			_unrecorded_ever.store( true, std::memory_order_relaxed );
+		}
+		return 0;
+	}
+	if ( call_site_only ) [[unlikely]]
+	{
+		block->stack_id = StackDepot::intern( StackTrace::of_call_site(call_site) );
+	}
+	block->weight = weight;
+	block->generation = _generation.load(std::memory_order_relaxed);
+	block->epoch      = _epoch     .load(std::memory_order_relaxed);
+	if constexpr ( Policy::lifetimes ) _churn_alloc(block);
+	_site_totals_add( *block, 1 );
+	_filter_add(ptr);
+	_insert_block<Policy::thread_logs>( &blocks, block );
+
+	Policy::post_alloc( *this, ptr, alignment, size );
+
+	return block->_slot + 1;
+}
+//Removes the record of a block from wherever it is, or returns `nullptr` if there's none.
+template< bool thread_logs >
+[[nodiscard]] static MemoryTracer::BlockInfo* _extract_block(
+	MemoryTracer::BlockRegistry* blocks, void const* ptr
+) noexcept {
+	if constexpr ( !thread_logs ) return blocks->extract(ptr);
+
+	MemoryTracer::BlockInfo* block = nullptr;
+	if ( _ThreadLog* log=_this_thread_log(); log!=nullptr ) [[likely]]
+	{
+		std::lock_guard lock_raii(log->mutex);
+		block = log->extract(ptr);
+	}
+	if ( block == nullptr ) block=blocks->extract(ptr);
+	if ( block == nullptr ) [[unlikely]]
+	{
+		//Allocated recently by another thread?  If it isn't pending there, it may have been
+		//	published while we were searching, so check the registry once more.
+		block = _extract_from_thread_logs(ptr);
+		if ( block == nullptr ) block=blocks->extract(ptr);
+	}
+	return block;
+}
+
+//Whether a pointer with no record may just be of a block that wasn't recorded, rather than a bad
+//	one.  The tracer's own blocks (freed while internal) never are; other blocks only go unrecorded
+//	once something (e.g. not recording, or sampling) has left one out.
+[[nodiscard]] static bool _may_be_unrecorded( MemoryTracerBase const& tracer ) noexcept
+{
+	return _tl_internal ||
+		tracer._unrecorded_ever.load(std::memory_order_relaxed) ||
+		tracer._sampled_ever   .load(std::memory_order_relaxed);
+}
+
+template< class Policy >
+size_t BasicMemoryTracer<Policy>::record_dealloc( void* ptr, size_t alignment, size_t size/*=unknown_size*/ )
+{
+	if ( ptr == nullptr ) return unknown_size;
+
+	//Note: this doesn't depend on the calling thread's mode, nor on whether it's internal (e.g. in
+	//	a callback), since the block may have been recorded by a thread that was recording (leaving
+	//	the record behind would make it a false leak).  Blocks that were never recorded, such as
+	//	the tracer's own, are rejected by the filter, still without locking.  The exception is
+	//	during a walk of the registry (see `BlockRegistry::_WalkScope`), where we can't lock it.
+	if ( _tl_walking != 0 ) [[unlikely]] return unknown_size;
+
+	if ( !_filter_maybe_contains(ptr) )
+	{
+		//Never recorded (e.g., allocated while not recording, or not sampled)
+		TINYLEAKCHECK_ASSERT(
+			_may_be_unrecorded(*this),
+			"Deleting an invalid pointer 0x%p!", ptr
+		);
+		return unknown_size;
+	}
+
+	InternalScope internal;
+
+	Policy::pre_dealloc( *this, ptr, alignment );
+
+	BlockInfo* block = _extract_block<Policy::thread_logs>( &blocks, ptr );
+	if ( block == nullptr ) [[unlikely]]
+	{
+		//Either a bad pointer, or a filter collision with an unrecorded block
+		TINYLEAKCHECK_ASSERT(
+			_may_be_unrecorded(*this),
+			"Deleting an invalid pointer 0x%p!", ptr
+		);
+		return unknown_size;
+	}
+	TINYLEAKCHECK_ASSERT(
+		size==unknown_size || size==block->size,
+		"Deleting 0x%p with size %zu, but it was allocated with size %zu!", ptr, size, block->size
+	);
+	if constexpr ( Policy::lifetimes ) _churn_free(*block);
+	_site_totals_add( *block, -1 );
+	_filter_remove(ptr);
+	size_t recorded_size = block->size;
+	_BlockPool::destroy(block);
+	return recorded_size;
+}
+template< class Policy >
+void BasicMemoryTracer<Policy>::_record_dealloc( std::uint32_t slot, void* ptr )
+{
+	//Note: like `.record_dealloc(⋯)`, this doesn't depend on the current mode.  The block is known
+	//	to be recorded, and leaving the record behind would only make it a false leak.
+	if ( _tl_walking != 0 ) [[unlikely]] return;
+	InternalScope internal;
+
+	BlockInfo* block = _BlockPool::at( slot - 1 );
+	TINYLEAKCHECK_ASSERT( block->ptr==ptr, "Header of 0x%p is corrupt!", ptr );
+	if ( block->ptr != ptr ) [[unlikely]] return;
+
+	Policy::pre_dealloc( *this, ptr, block->alignment );
+
+	//The record is either pending in some thread's log, or in the registry.  It can move from the
+	//	former to the latter at any time (when the log is published), but not back.  Logs are never
+	//	freed, so the one it was seen in can be locked even if its thread has exited; then, if the
+	//	record is still there, it's found among at most `TINYLEAKCHECK_THREAD_LOG_SIZE` others.
+	//	Otherwise, it's unlinked from its registry bucket directly.  Either way, there's no lookup.
+	bool pending = false;
+	if ( _ThreadLog* log=block->_log.load(std::memory_order_acquire); log!=nullptr )
+	{
+		std::lock_guard lock_raii(log->mutex);
+		if ( block->_log.load(std::memory_order_relaxed) == log )
+		{
+			[[maybe_unused]] BlockInfo* found = log->extract(ptr);
+			TINYLEAKCHECK_ASSERT( found==block, "Implementation error!" );
+			pending = true;
+		}
+	}
+	if ( !pending ) blocks.unlink(block);
+
+	if constexpr ( Policy::lifetimes ) _churn_free(*block);
+	_site_totals_add( *block, -1 );
+	_filter_remove(ptr);
+	_BlockPool::destroy(block);
+}
+
+template< class Policy >
+size_t BasicMemoryTracer<Policy>::record_realloc(
+	void* old_ptr, void* new_ptr, size_t size, void const* call_site/*=nullptr*/
+) {
+	if ( call_site == nullptr ) call_site=TINYLEAKCHECK_RETURN_ADDRESS();
+	BlockInfo* block = _realloc_begin(old_ptr);
+	size_t old_size = block!=nullptr ? block->size : unknown_size;
+	_realloc_end( block, new_ptr, size, call_site );
+	return old_size;
+}
+template< class Policy >
+[[nodiscard]] MemoryTracerBase::BlockInfo* BasicMemoryTracer<Policy>::_realloc_begin( void* old_ptr )
+{
+	//As for `.record_dealloc(⋯)`
+	if ( old_ptr==nullptr || _tl_walking!=0 ) return nullptr;
+	if ( !_filter_maybe_contains(old_ptr) )
+	{
+		TINYLEAKCHECK_ASSERT(
+			_may_be_unrecorded(*this),
+			"Reallocating an invalid pointer 0x%p!", old_ptr
+		);
+		return nullptr;
+	}
+
+	InternalScope internal;
+
+	BlockInfo* block = _extract_block<Policy::thread_logs>( &blocks, old_ptr );
+	if ( block == nullptr ) [[unlikely]]
+	{
+		TINYLEAKCHECK_ASSERT(
+			_may_be_unrecorded(*this),
+			"Reallocating an invalid pointer 0x%p!", old_ptr
+		);
+		return nullptr;
+	}
+	Policy::pre_dealloc( *this, old_ptr, block->alignment );
+	_site_totals_add( *block, -1 );
+	_filter_remove(old_ptr);
+	return block;
+}
+template< class Policy >
+void BasicMemoryTracer<Policy>::_realloc_end( BlockInfo* block, void* new_ptr, size_t size, void const* call_site )
+{
+	if ( block == nullptr )
+	{
+		//The old block wasn't recorded, but the new one might be (e.g., sampled)
+		if ( new_ptr != nullptr ) (void)_record_alloc( new_ptr, alignof(std::max_align_t), size, call_site );
+		return;
+	}
+
+	InternalScope internal;
+
+	//Same record, same stack; only the address and size change (unless the reallocation failed, in
+	//	which case it is put back as it was).
+	if ( new_ptr != nullptr )
+	{
+		block->ptr  = new_ptr;
+		block->size = size;
+	}
+	_site_totals_add( *block, 1 );
+	_filter_add( block->ptr );
+	_insert_block<Policy::thread_logs>( &blocks, block );
+
+	Policy::post_alloc( *this, block->ptr, block->alignment, block->size );
+}
+
+template struct BasicMemoryTracer<TINYLEAKCHECK_POLICY>;
+
+//Helpers for grouping blocks by site
+static void _add_to_site(
+	_UntracedMap< StackDepot::Id, MemoryTracer::Site >* sites, MemoryTracer::BlockInfo const& block
+) {
+	MemoryTracer::Site& site = sites->try_emplace( block.stack_id ).first->second;
+	site.stack_id = block.stack_id;
+	if ( site.count < MemoryTracer::Site::max_samples ) site.samples[site.sample_count++]=block.ptr;
+	++site.count;
+	site.bytes += block.size;
+	site.estimated_count += static_cast<double>( block.weight );
+	site.estimated_bytes += static_cast<double>( block.weight ) * static_cast<double>( block.size );
+}
+static void _sort_sites( std::vector<MemoryTracer::Site>* sites )
+{
+	std::sort( sites->begin(),sites->end(), []( MemoryTracer::Site const& a, MemoryTracer::Site const& b )
+	{
+		return a.bytes!=b.bytes ? a.bytes>b.bytes : a.stack_id<b.stack_id;
+	} );
+}
+[[nodiscard]] static std::vector<MemoryTracer::Site> _sorted_sites(
+	_UntracedMap< StackDepot::Id, MemoryTracer::Site > const& sites
+) {
+	std::vector<MemoryTracer::Site> result;
+	result.reserve( sites.size() );
+	for ( auto const& iter : sites ) result.push_back(iter.second);
+	_sort_sites( &result );
+	return result;
+}
+
+[[nodiscard]] std::vector<MemoryTracerBase::Site> MemoryTracerBase::collect_sites() const
+{
+	_UntracedMap< StackDepot::Id, Site > sites;
+	blocks.for_each( [&sites]( BlockInfo const& block ){ _add_to_site( &sites, block ); } );
+	return _sorted_sites(sites);
+}
+
+[[nodiscard]] std::vector<MemoryTracerBase::Site> MemoryTracerBase::collect_folded_sites() const
+{
+	std::vector<Site> result;
+	if ( !_folded_ever.load(std::memory_order_relaxed) ) [[likely]] return result;
+
+	std::size_t count = StackDepot::size();
+	for ( std::size_t id=1; id<=count; ++id )
+	{
+		_SiteTotals const* totals = _site_totals( static_cast<StackDepot::Id>(id), false );
+		if ( totals == nullptr ) continue;
+		std::uint64_t folded = totals->folded_count.load(std::memory_order_relaxed);
+		if ( folded == 0 ) continue;
+
+		Site& site = result.emplace_back();
+		site.stack_id = static_cast<StackDepot::Id>(id);
+		site.count = static_cast<std::size_t>(folded);
+		site.bytes = static_cast<std::size_t>( totals->folded_bytes.load(std::memory_order_relaxed) );
+		site.estimated_count = static_cast<double>(site.count);
+		site.estimated_bytes = static_cast<double>(site.bytes);
+	}
+	_sort_sites( &result );
+	return result;
+}
+
+[[nodiscard]] std::vector<MemoryTracerBase::Site> MemoryTracerBase::collect_sites_older_than(
+	std::uint64_t age
+) {
+	std::uint64_t epoch = get_epoch();
+	if ( age > epoch ) return {};
+
+	flush();
+	_UntracedMap< StackDepot::Id, Site > sites;
+	blocks.for_each_until_epoch( epoch-age, [&sites]( BlockInfo const& block )
+	{
+		_add_to_site( &sites, block );
+	} );
+	return _sorted_sites(sites);
+}
+
+//Calls `fn(entry)` with the live totals of each site that has live blocks, by increasing stack id.
+template< class Fn > static void _for_each_live_site( Fn&& fn )
+{
+	StackDepot::Id end = static_cast<StackDepot::Id>( StackDepot::size() ) + 1;
+	for ( StackDepot::Id id=0; id<end; ++id )
+	{
+		_SiteTotals const* totals = _site_totals( id, false );
+		if ( totals == nullptr )
+		{
+			//Whole page untouched
+			id |= (1u<<_depot_page_bits) - 1;
+			continue;
+		}
+
+		MemoryTracer::Snapshot::Entry entry;
+		entry.stack_id = id;
+		entry.count = totals->count.load(std::memory_order_relaxed);
+		entry.bytes = totals->bytes.load(std::memory_order_relaxed);
+		if ( entry.count == 0 ) continue;
+		entry.estimated_count = static_cast<double>(entry.count) + totals->extra_count.load(std::memory_order_relaxed);
+		entry.estimated_bytes = static_cast<double>(entry.bytes) + totals->extra_bytes.load(std::memory_order_relaxed);
+		fn( entry );
+	}
+}
+
+[[nodiscard]] MemoryTracerBase::Snapshot MemoryTracerBase::snapshot() noexcept
+{
+	Snapshot result;
+	result.generation = _generation.fetch_add( 1, std::memory_order_relaxed ) + 1;
+	_for_each_live_site( [&result]( Snapshot::Entry const& entry ){ result.sites.push_back(entry); } );
+	return result;
+}
+
+[[nodiscard]] std::vector<MemoryTracerBase::Site> MemoryTracerBase::diff(
+	Snapshot const& before, Snapshot const& after
+) {
+	std::vector<Site> result;
+
+	//Both are sorted by id; merge
+	auto iter0=before.sites.cbegin(), iter1=after.sites.cbegin();
+	while ( iter1 != after.sites.cend() )
+	{
+		while ( iter0!=before.sites.cend() && iter0->stack_id<iter1->stack_id ) ++iter0;
+		Snapshot::Entry const* prev = iter0!=before.sites.cend() && iter0->stack_id==iter1->stack_id ?
+			&*iter0 : nullptr;
+
+		std::int64_t grown_count = iter1->count - ( prev!=nullptr ? prev->count : 0 );
+		std::int64_t grown_bytes = iter1->bytes - ( prev!=nullptr ? prev->bytes : 0 );
+		if ( grown_count>0 || grown_bytes>0 )
+		{
+			Site site;
+			site.stack_id = iter1->stack_id;
+			site.count = static_cast<std::size_t>( std::max( grown_count, std::int64_t(0) ) );
+			site.bytes = static_cast<std::size_t>( std::max( grown_bytes, std::int64_t(0) ) );
+			site.estimated_count = std::max( iter1->estimated_count - ( prev!=nullptr ? prev->estimated_count : 0.0 ), 0.0 );
+			site.estimated_bytes = std::max( iter1->estimated_bytes - ( prev!=nullptr ? prev->estimated_bytes : 0.0 ), 0.0 );
+			result.push_back(site);
+		}
+		++iter1;
+	}
+	if ( result.empty() ) return result;
+
+	std::sort( result.begin(),result.end(), []( Site const& a, Site const& b )
+	{
+		return a.stack_id < b.stack_id;
+	} );
+	auto sample = [&]( BlockInfo const& block )
+	{
+		auto iter = std::lower_bound( result.begin(),result.end(), block.stack_id,
+			[]( Site const& site, StackDepot::Id id ){ return site.stack_id < id; }
+		);
+		if ( iter==result.end() || iter->stack_id!=block.stack_id ) return;
+		if ( iter->sample_count < Site::max_samples ) iter->samples[iter->sample_count++]=block.ptr;
+	};
+	if ( after.generation > before.generation )
+	{
+		//Only the blocks recorded in between can be samples
+		flush();
+		blocks.for_each_in_generations( before.generation, after.generation-1, sample );
+	}
+
+	_sort_sites( &result );
+	return result;
+}
+
+void MemoryTracerBase::write_heap_profile( FILE* file )
+{
+	InternalScope internal;
+
+	//Aggregated per site already; gather them (for the header totals), then format into one large
+	//	buffer, written out whenever it fills.
+	std::vector<Snapshot::Entry> sites;
+	std::uint64_t total_count=0, total_bytes=0;
+	_for_each_live_site( [&]( Snapshot::Entry const& entry )
+	{
+		if ( entry.stack_id == 0 ) return; //No stack to attribute it to
+		Snapshot::Entry& added = sites.emplace_back(entry);
+		//Sampled profiles are written already scaled up to the estimates
+		added.count = static_cast<std::int64_t>( std::llround(entry.estimated_count) );
+		added.bytes = static_cast<std::int64_t>( std::llround(entry.estimated_bytes) );
+		total_count += static_cast<std::uint64_t>(added.count);
+		total_bytes += static_cast<std::uint64_t>(added.bytes);
+	} );
+
+	std::string buffer;
+	buffer.reserve( 1 << 16 );
+	auto drain = [&]( bool force )
+	{
+		if ( !force && buffer.size()<(1<<16)-1024 ) return;
+		fwrite( buffer.data(), 1,buffer.size(), file );
+		buffer.clear();
+	};
+
+	buffer += std::format(
+		"heap profile: {:6}: {:8} [{:6}: {:8}] @ heapprofile\n",
+		total_count, total_bytes, total_count, total_bytes
+	);
+	for ( Snapshot::Entry const& entry : sites )
+	{
+		//(No cumulative totals are kept per site, so the "allocated" columns repeat "in use".)
+		buffer += std::format(
+			"{:6}: {:8} [{:6}: {:8}] @", entry.count, entry.bytes, entry.count, entry.bytes
+		);
+		for ( void* frame : StackDepot::get(entry.stack_id) )
+		{
+			buffer += std::format( " {:p}", frame );
+		}
+		buffer += '\n';
+		drain( false );
+	}
+
+	//Lets `pprof` map addresses back to binaries
+	#ifdef __linux__
+		buffer += "\nMAPPED_LIBRARIES:\n";
+		drain( true );
+		if ( FILE* maps=fopen("/proc/self/maps","r"); maps!=nullptr )
+		{
+			char chunk[ 4096 ];
+			for ( std::size_t read; (read=fread(chunk,1,sizeof(chunk),maps))>0; ) fwrite( chunk,1,read, file );
+			fclose(maps);
+		}
+	#endif
+	drain( true );
+	fflush(file);
+}
+
+[[nodiscard]] std::vector<MemoryTracerBase::ChurnSite> MemoryTracerBase::collect_churn() const
+{
+	std::vector<ChurnSite> result;
+	double seconds = static_cast<double>(
+		_timestamp_ns() - _churn_start_ns.load(std::memory_order_relaxed)
+	) * 1e-9;
+
+	std::size_t count = StackDepot::size();
+	for ( std::size_t id=0; id<=count; ++id ) //(Including zero, for blocks without stacks)
+	{
+		_SiteTotals const* totals = _site_totals( static_cast<StackDepot::Id>(id), false );
+		if ( totals == nullptr ) continue;
+		std::uint64_t allocations = totals->allocations.load(std::memory_order_relaxed);
+		if ( allocations == 0 ) continue;
+
+		ChurnSite& site = result.emplace_back();
+		site.stack_id = static_cast<StackDepot::Id>(id);
+		site.allocations = allocations;
+		if ( seconds > 0.0 ) site.allocation_rate=static_cast<double>(allocations)/seconds;
+		if ( _SiteLifetimes const* lifetimes=totals->lifetimes.load(std::memory_order_acquire); lifetimes!=nullptr )
+		{
+			for ( std::size_t k=0; k<ChurnSite::lifetime_buckets; ++k )
+			{
+				site.lifetimes[k] = lifetimes->buckets[k].load(std::memory_order_relaxed);
+				site.frees += site.lifetimes[k];
+			}
+		}
+
+		//Upper bound of the median's bucket (the last has none, so its lower bound instead)
+		std::uint64_t seen = 0;
+		for ( std::size_t k=0; k<ChurnSite::lifetime_buckets && site.frees>0; ++k )
+		{
+			seen += site.lifetimes[k];
+			if ( 2*seen < site.frees ) continue;
+			site.median_lifetime_ns = k+1<ChurnSite::lifetime_buckets ? std::uint64_t(1)<<(k+6) : std::uint64_t(1)<<(k+5);
+			break;
+		}
+	}
+	std::sort( result.begin(),result.end(), []( ChurnSite const& a, ChurnSite const& b )
+	{
+		return a.allocations > b.allocations;
+	} );
+	return result;
+}
+
+//E.g. "512 ns", "65.5 µs", "2.1 s"; lifetimes are only known to within a power of two anyway.
+[[nodiscard]] static std::string _format_lifetime( std::uint64_t ns )
+{
+	auto value = static_cast<double>(ns);
+	if ( ns < 1'000         ) return std::format( "{} ns"   , ns          );
+	if ( ns < 1'000'000     ) return std::format( "{:.3g} µs", value*1e-3 );
+	if ( ns < 1'000'000'000 ) return std::format( "{:.3g} ms", value*1e-6 );
+	return                           std::format( "{:.3g} s" , value*1e-9 );
+}
+
+void MemoryTracerBase::write_churn_report( FILE* file/*=stderr*/, std::size_t top/*=10*/ ) const
+{
+	InternalScope internal;
+
+	std::vector<ChurnSite> sites = collect_churn();
+	std::uint64_t total = 0;
+	for ( ChurnSite const& site : sites ) total+=site.allocations;
+
+	//By rate (the order `.collect_churn()` returns), then by shortest median lifetime, among sites
+	//	busy enough to matter
+	std::vector<ChurnSite const*> by_rate, by_lifetime;
+	for ( ChurnSite const& site : sites )
+	{
+		if ( by_rate.size() < top ) by_rate.push_back(&site);
+		if ( site.frees>0 && site.allocations*1000>=total ) by_lifetime.push_back(&site);
+	}
+	std::sort( by_lifetime.begin(),by_lifetime.end(), []( ChurnSite const* a, ChurnSite const* b )
+	{
+		if ( a->median_lifetime_ns != b->median_lifetime_ns ) return a->median_lifetime_ns < b->median_lifetime_ns;
+		return a->allocations > b->allocations;
+	} );
+	if ( by_lifetime.size() > top ) by_lifetime.resize(top);
+
+	std::optional<_Symbolizer> local;
+	if ( _tl_symbolizer == nullptr ) local.emplace();
+	_Symbolizer& symbolizer = _tl_symbolizer!=nullptr ? *_tl_symbolizer : *local;
+	{
+		std::vector<StackDepot::Id> stack_ids;
+		for ( ChurnSite const* site : by_rate     ) stack_ids.push_back( site->stack_id );
+		for ( ChurnSite const* site : by_lifetime ) stack_ids.push_back( site->stack_id );
+		symbolizer.prefetch( stack_ids );
+	}
+
+	std::string buffer = std::format(
+		"Allocation churn: {} blocks recorded at {} sites, over {:.3f} s.\n", total, sites.size(),
+		static_cast<double>( _timestamp_ns() - _churn_start_ns.load(std::memory_order_relaxed) ) * 1e-9
+	);
+	auto append = [&]( char const* title, std::vector<ChurnSite const*> const& list )
+	{
+		buffer += '\n';
+		buffer += title;
+		buffer += ":\n";
+		for ( ChurnSite const* site : list )
+		{
+			buffer += std::format(
+				"  {} allocations ( {:.1f}/s ), {} freed", site->allocations, site->allocation_rate, site->frees
+			);
+			if ( site->frees > 0 ) buffer += std::format( ", median lifetime < {}", _format_lifetime(site->median_lifetime_ns) );
+			symbolizer.append_stack( &buffer, site->stack_id );
+			if ( site->frees == 0 ) continue;
+
+			buffer += "    lifetimes:";
+			for ( std::size_t k=0; k<ChurnSite::lifetime_buckets; ++k )
+			{
+				if ( site->lifetimes[k] == 0 ) continue;
+				if ( k+1 < ChurnSite::lifetime_buckets )
+				{
+					buffer += std::format( " <{}: {}", _format_lifetime(std::uint64_t(1)<<(k+6)), site->lifetimes[k] );
+				}
+				else
+				{
+					buffer += std::format( " ≥{}: {}", _format_lifetime(std::uint64_t(1)<<(k+5)), site->lifetimes[k] );
+				}
+			}
+			buffer += '\n';
+		}
+		fwrite( buffer.data(), 1,buffer.size(), file );
+		buffer.clear();
+	};
+	append( "Top sites by allocation rate", by_rate );
+	append( "Top sites by shortest median lifetime", by_lifetime );
+	fflush(file);
+}
+
+void MemoryTracerBase::flush() noexcept
+{
+	InternalScope internal;
+
+	std::lock_guard lock_raii(_thread_logs_mutex);
+	for ( _ThreadLog* log=_thread_logs; log!=nullptr; log=log->next )
+	{
+		std::lock_guard lock_raii2(log->mutex);
+		log->publish_oldest( log->count );
+	}
+}
+
+
+
+/*
+Backends: the allocators underneath the tracer.  These must work from the very first allocation
+(which may be during static initialization), so they're constant-initialized, and the one to use
+is selected on first use.
+
+The size-class backend is a simple thread-caching allocator in the style of tcmalloc.  Small
+requests are rounded up to one of a few dozen size classes, and each thread keeps a free list per
+class, refilled from and returned to a shared list per class in batches.  Blocks are carved out of
+64 KiB spans, which are never returned to the system, and a two-level map from span address to
+class tells a deallocation (which may not know the size) which list the block belongs on, or that
+it's a large block to hand back to the system.
+*/
+
+[[nodiscard]] static void* _system_aligned_alloc( std::size_t alignment, std::size_t size ) noexcept
+{
+	#ifdef _WIN32
+		return _aligned_malloc( size, alignment );
+	#else
+		void* result;
+		alignment = std::max( alignment, sizeof(void*) );
+		return _libc_posix_memalign( &result, alignment, size )==0 ? result : nullptr;
+	#endif
+}
+static void _system_aligned_free( void* ptr ) noexcept
+{
+	#ifdef _WIN32
+		_aligned_free(ptr);
+	#else
+		_libc_free(ptr);
+	#endif
+}
+
+[[nodiscard]] static void* _backend_malloc_alloc( std::size_t alignment, std::size_t size ) noexcept
+{
+	if ( alignment <= __STDCPP_DEFAULT_NEW_ALIGNMENT__ ) [[likely]] return _libc_malloc(size);
+	return aligned_malloc( alignment, size );
+}
+static void _backend_malloc_dealloc( void* ptr, std::size_t alignment, std::size_t /*size*/ ) noexcept
+{
+	if ( alignment <= __STDCPP_DEFAULT_NEW_ALIGNMENT__ ) [[likely]] _libc_free(ptr);
+	else aligned_free(ptr);
+}
+
+[[nodiscard]] static void* _backend_memalign_alloc( std::size_t alignment, std::size_t size ) noexcept
+{
+	return _system_aligned_alloc( alignment, size );
+}
+static void _backend_memalign_dealloc( void* ptr, std::size_t /*alignment*/, std::size_t /*size*/ ) noexcept
+{
+	_system_aligned_free(ptr);
+}
+
+class _SizeClasses final
+{
+	public:
+		static constexpr std::size_t span_bits  = 16;
+		static constexpr std::size_t span_size  = std::size_t(1) << span_bits;
+		//Sizes 16, 32, ⋯, 128, and then four classes per doubling up to 16 KiB
+		static constexpr std::size_t count      = 8 + 4*(14-7);
+		static constexpr std::size_t max_size   = 16384;
+
+	private:
+		struct _FreeBlock final { _FreeBlock* next; };
+
+		struct alignas(64) _Shared final
+		{
+			std::mutex mutex;
+			_FreeBlock* head = nullptr;
+		};
+		static _Shared _shared[ count ];
+
+		struct _Cache final
+		{
+			_FreeBlock* heads [ count ] = {};
+			std::uint32_t counts[ count ] = {};
+			~_Cache() noexcept;
+		};
+		static thread_local bool _tl_cache_dead;
+
+		//Span map: class+1 of each span (zero if not one of ours), by address
+		static std::atomic< std::atomic<std::uint8_t>* > _span_map[ std::size_t(1) << 16 ];
+
+	public:
+		[[nodiscard]] static constexpr std::size_t size_of( std::size_t index ) noexcept
+		{
+			if ( index < 8 ) return 16 * (index+1);
+			std::size_t j = index - 8;
+			std::size_t lg = 7 + j/4;
+			return ( std::size_t(1) << lg ) + ( j%4 + 1 ) * ( std::size_t(1) << (lg-2) );
+		}
+		[[nodiscard]] static std::size_t index_of( std::size_t size ) noexcept
+		{
+			if ( size <= 128 ) return size==0 ? 0 : (size-1)/16;
+			std::size_t lg = static_cast<std::size_t>( std::bit_width(size-1) ) - 1;
+			return 8 + (lg-7)*4 + ( ( (size-1) - (std::size_t(1)<<lg) ) >> (lg-2) );
+		}
+		//Number of blocks moved between a thread's cache and the shared list at once
+		[[nodiscard]] static constexpr std::uint32_t batch_of( std::size_t index ) noexcept
+		{
+			return static_cast<std::uint32_t>( std::clamp( 8192/size_of(index), std::size_t(2), std::size_t(64) ) );
+		}
+
+		[[nodiscard]] static void* alloc( std::size_t alignment, std::size_t size ) noexcept;
+		static void dealloc( void* ptr ) noexcept;
+
+	private:
+		[[nodiscard]] static _Cache* _this_thread_cache() noexcept
+		{
+			if ( _tl_cache_dead ) [[unlikely]] return nullptr;
+			static thread_local _Cache cache;
+			return &cache;
+		}
+
+		[[nodiscard]] static std::atomic<std::uint8_t>* _span_entry( void const* ptr, bool create ) noexcept;
+
+		//Takes up to `num` blocks from the shared list (carving a new span if it's empty).  Returns
+		//	the number taken, linked from `*head`.
+		[[nodiscard]] static std::uint32_t _take( std::size_t index, std::uint32_t num, _FreeBlock** head ) noexcept;
+		static void _give( std::size_t index, _FreeBlock* first, _FreeBlock* last ) noexcept;
+};
+static_assert( _SizeClasses::size_of( _SizeClasses::count-1 ) == _SizeClasses::max_size );
+#ifdef __clang__
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wexit-time-destructors"
+	#pragma clang diagnostic ignored "-Wglobal-constructors"
+#endif
+_SizeClasses::_Shared _SizeClasses::_shared[ _SizeClasses::count ];
+#ifdef __clang__
+	#pragma clang diagnostic pop
+#endif
+thread_local bool _SizeClasses::_tl_cache_dead = false;
+std::atomic< std::atomic<std::uint8_t>* > _SizeClasses::_span_map[ std::size_t(1) << 16 ];
+
+_SizeClasses::_Cache::~_Cache() noexcept
+{
+	_tl_cache_dead = true;
+	for ( std::size_t index=0; index<count; ++index )
+	{
+		if ( heads[index] == nullptr ) continue;
+		_FreeBlock* last = heads[index];
+		while ( last->next != nullptr ) last=last->next;
+		_give( index, heads[index], last );
+	}
+}
+
+[[nodiscard]] std::atomic<std::uint8_t>* _SizeClasses::_span_entry(
+	void const* ptr, bool create
+) noexcept {
+	//Covers a 48-bit address space: 2¹⁶ leaves, each covering 2¹⁶ spans
+	std::uint64_t span = static_cast<std::uint64_t>( std::bit_cast<uintptr_t>(ptr) ) >> span_bits;
+	if ( span >> 32 != 0 ) [[unlikely]] return nullptr;
+
+	std::atomic< std::atomic<std::uint8_t>* >& root = _span_map[ span >> 16 ];
+	std::atomic<std::uint8_t>* leaf = root.load(std::memory_order_acquire);
+	if ( leaf == nullptr )
+	{
+		if ( !create ) return nullptr;
+		auto* fresh = static_cast<std::atomic<std::uint8_t>*>(
+			_libc_calloc( std::size_t(1)<<16, sizeof(std::atomic<std::uint8_t>) )
+		);
+		if ( fresh == nullptr ) [[unlikely]] return nullptr;
+		if ( root.compare_exchange_strong( leaf,fresh, std::memory_order_acq_rel ) ) leaf=fresh;
+		else _libc_free(fresh); //Lost the race; `leaf` is now the winner's
+	}
+	return leaf + ( span & 0xFFFF );
+}
+
+[[nodiscard]] std::uint32_t _SizeClasses::_take(
+	std::size_t index, std::uint32_t num, _FreeBlock** head
+) noexcept {
+	_Shared& shared = _shared[index];
+	std::lock_guard lock_raii(shared.mutex);
+
+	if ( shared.head == nullptr )
+	{
+		auto* span = static_cast<std::uint8_t*>( _system_aligned_alloc( span_size, span_size ) );
+		if ( span == nullptr ) [[unlikely]] return 0;
+		std::atomic<std::uint8_t>* entry = _span_entry( span, true );
+		if ( entry == nullptr ) [[unlikely]]
+		{
+			_system_aligned_free(span);
+			return 0;
+		}
+		entry->store( static_cast<std::uint8_t>(index+1), std::memory_order_relaxed );
+
+		std::size_t block_size = size_of(index);
+		for ( std::size_t offset=span_size/block_size*block_size; offset>0; )
+		{
+			offset -= block_size;
+			auto* block = reinterpret_cast<_FreeBlock*>( span + offset );
+			block->next = shared.head;
+			shared.head = block;
+		}
+	}
+
+	std::uint32_t taken = 0;
+	_FreeBlock* first = shared.head;
+	_FreeBlock* last  = nullptr;
+	for ( _FreeBlock* block=first; block!=nullptr && taken<num; block=block->next )
+	{
+		last = block;
+		++taken;
+	}
+	shared.head = last->next;
+	last->next = nullptr;
+	*head = first;
+	return taken;
+}
+void _SizeClasses::_give( std::size_t index, _FreeBlock* first, _FreeBlock* last ) noexcept
+{
+	_Shared& shared = _shared[index];
+	std::lock_guard lock_raii(shared.mutex);
+	last->next = shared.head;
+	shared.head = first;
+}
+
+[[nodiscard]] void* _SizeClasses::alloc( std::size_t alignment, std::size_t size ) noexcept
+{
+	//Blocks are aligned to the largest power of two dividing their class size (as spans are
+	//	aligned to theirs), and every doubling has a power-of-two class, so just round up.
+	if ( std::max(size,alignment) > max_size ) [[unlikely]]
+	{
+		return _system_aligned_alloc( std::max(alignment,std::size_t(__STDCPP_DEFAULT_NEW_ALIGNMENT__)), size );
+	}
+	std::size_t index = index_of( std::max(size,alignment) );
+	while ( size_of(index)%alignment != 0 ) ++index;
+
+	_Cache* cache = _this_thread_cache();
+	if ( cache == nullptr ) [[unlikely]]
+	{
+		_FreeBlock* block;
+		return _take( index, 1, &block )!=0 ? block : nullptr;
+	}
+
+	if ( cache->heads[index] == nullptr ) [[unlikely]]
+	{
+		cache->counts[index] = _take( index, batch_of(index), &cache->heads[index] );
+		if ( cache->counts[index] == 0 ) [[unlikely]] return nullptr;
+	}
+	_FreeBlock* block = cache->heads[index];
+	cache->heads[index] = block->next;
+	--cache->counts[index];
+	return block;
+}
+void _SizeClasses::dealloc( void* ptr ) noexcept
+{
+	std::atomic<std::uint8_t>* entry = _span_entry( ptr, false );
+	std::uint8_t tag = entry!=nullptr ? entry->load(std::memory_order_relaxed) : 0;
+	if ( tag == 0 ) [[unlikely]]
+	{
+		_system_aligned_free(ptr);
+		return;
+	}
+	std::size_t index = tag - 1u;
+
+	auto* block = static_cast<_FreeBlock*>(ptr);
+	_Cache* cache = _this_thread_cache();
+	if ( cache == nullptr ) [[unlikely]]
+	{
+		block->next = nullptr;
+		_give( index, block, block );
+		return;
+	}
+
+	block->next = cache->heads[index];
+	cache->heads[index] = block;
+	if ( ++cache->counts[index] <= 2*batch_of(index) ) [[likely]] return;
+
+	//Overflowed; return a batch to the shared list
+	std::uint32_t num = batch_of(index);
+	_FreeBlock* first = cache->heads[index];
+	_FreeBlock* last  = first;
+	for ( std::uint32_t k=1; k<num; ++k ) last=last->next;
+	cache->heads[index] = last->next;
+	cache->counts[index] -= num;
+	_give( index, first, last );
+}
+
+[[nodiscard]] static void* _backend_sizeclass_alloc( std::size_t alignment, std::size_t size ) noexcept
+{
+	return _SizeClasses::alloc( alignment, size );
+}
+static void _backend_sizeclass_dealloc( void* ptr, std::size_t /*alignment*/, std::size_t /*size*/ ) noexcept
+{
+	_SizeClasses::dealloc(ptr);
+}
+
+constinit Backend const backend_malloc    = {
+	"malloc"   , _backend_malloc_alloc   , _backend_malloc_dealloc
+};
+constinit Backend const backend_memalign  = {
+	"memalign" , _backend_memalign_alloc , _backend_memalign_dealloc
+};
+constinit Backend const backend_sizeclass = {
+	"sizeclass", _backend_sizeclass_alloc, _backend_sizeclass_dealloc
+};
+
+static std::atomic<Backend const*> _backend = nullptr;
+[[nodiscard]] static Backend const* _select_backend() noexcept
+{
+	Backend const* candidates[] =
+	{
+		&backend_malloc, &backend_memalign, &backend_sizeclass,
+		#ifdef TINYLEAKCHECK_CUSTOM_BACKEND
+			&TINYLEAKCHECK_CUSTOM_BACKEND,
+		#endif
+	};
+	auto find = [&candidates]( char const* name ) -> Backend const*
+	{
+		for ( Backend const* candidate : candidates )
+		{
+			if ( strcmp( candidate->name, name ) == 0 ) return candidate;
+		}
+		return nullptr;
+	};
+
+	#if   defined TINYLEAKCHECK_BACKEND
+		Backend const* result = find( TINYLEAKCHECK_BACKEND );
+		TINYLEAKCHECK_ASSERT( result!=nullptr, "Unknown backend \"%s\"!", TINYLEAKCHECK_BACKEND );
+		if ( result == nullptr ) result=&backend_malloc;
+	#elif defined TINYLEAKCHECK_CUSTOM_BACKEND
+		Backend const* result = &TINYLEAKCHECK_CUSTOM_BACKEND;
+	#else
+		Backend const* result = &backend_malloc;
+	#endif
+
+	if ( char const* name=getenv("TINYLEAKCHECK_BACKEND"); name!=nullptr && *name!='\0' )
+	{
+		if ( Backend const* chosen=find(name); chosen!=nullptr ) result=chosen;
+		else fprintf( stderr, "TinyLeakCheck: unknown backend \"%s\"; using \"%s\".\n", name,result->name );
+	}
+
+	//If several threads race to get here, they all agree
+	Backend const* expected = nullptr;
+	if ( !_backend.compare_exchange_strong( expected,result, std::memory_order_acq_rel ) ) result=expected;
+	return result;
+}
+[[nodiscard]] Backend const& backend() noexcept
+{
+	Backend const* result = _backend.load(std::memory_order_acquire);
+	if ( result == nullptr ) [[unlikely]] result=_select_backend();
+	return *result;
+}
+
+
+
+#ifdef TINYLEAKCHECK_INBAND_HEADER
+/*
+In-band header, written immediately before every block returned by `operator new`.  It records
+everything `operator delete` needs: where the backend's allocation starts, and which record (if
+any) describes the block.  The tag distinguishes live blocks from freed ones and from pointers we never returned.
+Fields are read and written with `memcpy(⋯)`, since the header is only as aligned as the block.
+The tag is last (nearest the block), since `free(⋯)` tends to reuse the *start* of the underlying
+memory for its own bookkeeping, and we want the tag to survive that to catch double frees.
+*/
+struct _BlockHeader final
+{
+	std::size_t   size;
+	std::uint32_t alignment;
+	std::uint32_t offset;    //From the start of the underlying `malloc(⋯)`ed memory
+	std::uint32_t slot;      //One more than the index of the block's record, or zero if unrecorded
+	std::uint32_t magic;
+};
+static constexpr std::uint32_t _header_magic_live  = 0x4B41454Cu;
+static constexpr std::uint32_t _header_magic_freed = 0x45455246u;
+
+[[nodiscard]] inline static _BlockHeader _header_read( void const* ptr ) noexcept
+{
+	_BlockHeader header;
+	memcpy( &header, static_cast<uint8_t const*>(ptr)-sizeof(_BlockHeader), sizeof(_BlockHeader) );
+	return header;
+}
+inline static void _header_write( void* ptr, _BlockHeader const& header ) noexcept
+{
+	memcpy( static_cast<uint8_t*>(ptr)-sizeof(_BlockHeader), &header, sizeof(_BlockHeader) );
+}
+
+//Layout of a block with a header.  The header is padded out so the block keeps its alignment.
+[[nodiscard]] inline static std::size_t _header_alignment( std::size_t alignment ) noexcept
+{
+	return std::max( alignment, alignof(_BlockHeader) );
+}
+[[nodiscard]] inline static std::size_t _header_offset   ( std::size_t alignment ) noexcept
+{
+	alignment = _header_alignment(alignment);
+	return ( sizeof(_BlockHeader) + alignment-1 ) & ~(alignment-1);
+}
+#endif
+
+
+
+/*
+When a `MemoryTracer` exists, it can record allocations, and when it's deleted it can report the
+allocations that weren't freed as memory leaks.  So when should the instance `memory_tracer` be
+created and destroyed?
+
+We can't tie it closely to the `operator new(⋯)` / `operator delete(⋯)` functions, because the
+whole point is that these might be mismatched.  Another alternative is to make the user allocate /
+deallocate it.  This is inconvenient, and of course the user is trying to debug mismatched
+allocation / deallocation in the first place.  The right solution is to make it a namespace-scope
+variable.
+
+Note, however, that this solution (along with the previous, as it happens) has a subtle problem:
+allocation can happen during normal runtime, but get freed by the standard library after the fact,
+causing a false positive.  A (real) example is something like:
+	(1) Static construction of `memory_tracer`.
+	(2) Beginning of `main(⋯)`.
+	(3) User code does file IO, standard library allocates memory.
+	(4) End of `main(⋯)`.
+	(5) Static destruction of `memory_tracer`, leaks reported!
+	(6) Standard library cleans up allocated memory.
+This problem cannot be solved "correctly".  The code is functionally correct, and there's no way to
+detect this case.  Since the latest we can run code is with static destructors, we have no way of
+knowing whether the standard library does indeed clean up, or whether it represents a leak.
+
+At the same time, constructing the memory leak detector at namespace scope allows us to detect (at
+least some) static memory leaks, which is very useful.  So, we still do this.  The false positives
+are explicitly ignored.
+*/
+MemoryTracer* memory_tracer = nullptr;
+static bool _ready = false;
+//Statistics, unless the policy leaves them out.
+inline static void _stats_alloc( size_t size ) noexcept
+{
+	if constexpr ( MemoryTracer::Policy::statistics ) MemoryTracer::_count_alloc(size);
+	else (void)size;
+}
+inline static void _stats_dealloc( size_t size ) noexcept
+{
+	if constexpr ( MemoryTracer::Policy::statistics ) MemoryTracer::_count_dealloc(size);
+	else (void)size;
+}
+//Underlying allocation, from the backend.  With in-band headers, the header is placed in front.
+[[nodiscard]] inline static void* _raw_alloc( size_t alignment, size_t size ) noexcept
+{
+	#ifdef TINYLEAKCHECK_INBAND_HEADER
+		TINYLEAKCHECK_ASSERT(
+			alignment <= std::numeric_limits<std::uint32_t>::max(),
+			"Alignment %zu too large!", alignment
+		);
+		std::size_t offset = _header_offset(alignment);
+		auto* byteptr = static_cast<uint8_t*>(
+			backend().alloc( _header_alignment(alignment), offset+size )
+		);
+		if ( byteptr == nullptr ) [[unlikely]] return nullptr;
+
+		_BlockHeader header;
+		header.size      = size;
+		header.alignment = static_cast<std::uint32_t>(alignment);
+		header.offset    = static_cast<std::uint32_t>(offset);
+		header.slot      = 0;
+		header.magic     = _header_magic_live;
+		_header_write( byteptr+offset, header );
+
+		return byteptr + offset;
+	#else
+		return backend().alloc( alignment, size );
+	#endif
+}
+
+//Allocates and records, calling the new-handler on failure until it succeeds or there is no handler
+//	(in which case it returns `nullptr`; the handler might instead throw).
+[[nodiscard]] inline static void* _alloc( size_t alignment, size_t size, void const* call_site )
+{
+	if ( size == 0 ) size=1; //Distinct non-null pointer each time, as required
+
+	void* result;
+	while ( ( result=_raw_alloc(alignment,size) ) == nullptr ) [[unlikely]]
+	{
+		std::new_handler handler = std::get_new_handler();
+		if ( handler == nullptr ) return nullptr;
+		handler();
+	}
+
+	_stats_alloc(size);
+	if ( _events_open.load(std::memory_order_relaxed) ) [[unlikely]]
+	{
+		_events_write( EventStream::Op::alloc, result, size, alignment, call_site );
+	}
+
+	if (_ready) [[likely]]
+	{
+		#ifdef TINYLEAKCHECK_INBAND_HEADER
+			std::uint32_t slot = memory_tracer->_record_alloc( result, alignment, size, call_site );
+			if ( slot != 0 )
+			{
+				_BlockHeader header = _header_read(result);
+				header.slot = slot;
+				_header_write( result, header );
+			}
+		#else
+			memory_tracer->record_alloc( result, alignment, size, call_site );
+		#endif
+	}
+	return result;
+}
+[[nodiscard]] inline static void* _alloc_throwing( size_t alignment, size_t size, void const* call_site )
+{
+	void* result = _alloc( alignment, size, call_site );
+	if ( result == nullptr ) [[unlikely]] throw std::bad_alloc();
+	return result;
+}
+[[nodiscard]] inline static void* _alloc_nothrow( size_t alignment, size_t size, void const* call_site ) noexcept
+{
+	try { return _alloc( alignment, size, call_site ); }
+	catch ( std::bad_alloc const& ) { return nullptr; }
+}
+
+inline static void _dealloc( size_t alignment, void* ptr, size_t size=MemoryTracer::unknown_size ) noexcept
+{
+	if ( ptr == nullptr ) return;
+	if ( size == 0 ) size=1; //As allocated
+
+	#ifdef TINYLEAKCHECK_INBAND_HEADER
+		_BlockHeader header = _header_read(ptr);
+		if ( header.magic != _header_magic_live ) [[unlikely]]
+		{
+			TINYLEAKCHECK_ASSERT( header.magic!=_header_magic_freed, "Double free of 0x%p!", ptr );
+			TINYLEAKCHECK_ASSERT( false, "Deleting an invalid pointer 0x%p!", ptr );
+			return; //Leak it, rather than corrupt the heap
+		}
+		TINYLEAKCHECK_ASSERT(
+			alignment<=__STDCPP_DEFAULT_NEW_ALIGNMENT__ || alignment==header.alignment,
+			"Deleting 0x%p with alignment %zu, but it was allocated with alignment %u!",
+			ptr, alignment, static_cast<unsigned>(header.alignment)
+		);
+		TINYLEAKCHECK_ASSERT(
+			size==MemoryTracer::unknown_size || size==header.size,
+			"Deleting 0x%p with size %zu, but it was allocated with size %zu!", ptr, size, header.size
+		);
+
+		_stats_dealloc( header.size );
+		if ( _events_open.load(std::memory_order_relaxed) ) [[unlikely]]
+		{
+			_events_write( EventStream::Op::dealloc, ptr, header.size, alignment, nullptr );
+		}
+		if ( _ready && header.slot!=0 ) [[likely]] memory_tracer->_record_dealloc( header.slot, ptr );
+
+		header.magic = _header_magic_freed;
+		_header_write( ptr, header );
+		backend().dealloc(
+			static_cast<uint8_t*>(ptr) - header.offset,
+			_header_alignment(header.alignment), header.offset+header.size
+		);
+	#else
+		size_t known_size = size;
+		if (_ready) [[likely]]
+		{
+			size_t recorded_size = memory_tracer->record_dealloc( ptr, alignment, size );
+			if ( known_size == MemoryTracer::unknown_size ) known_size=recorded_size;
+		}
+		_stats_dealloc(known_size);
+		if ( _events_open.load(std::memory_order_relaxed) ) [[unlikely]]
+		{
+			_events_write( EventStream::Op::dealloc, ptr, known_size, alignment, nullptr );
+		}
+
+		backend().dealloc( ptr, alignment, size );
+	#endif
+}
+#ifdef TINYLEAKCHECK_PRELOAD
+//Bookkeeping for the interposed C allocation functions (see the bottom of this file), as for
+//	`operator new` / `delete`.  Blocks are recorded with the alignment `malloc(⋯)` guarantees.
+inline static void _c_alloced( void* ptr, size_t alignment, size_t size, void const* call_site ) noexcept
+{
+	if ( ptr == nullptr ) [[unlikely]] return;
+	_stats_alloc(size);
+	if ( _events_open.load(std::memory_order_relaxed) ) [[unlikely]]
+	{
+		_events_write( EventStream::Op::alloc, ptr, size, alignment, call_site );
+	}
+	if (_ready) [[likely]] memory_tracer->record_alloc( ptr, alignment, size, call_site );
+}
+inline static void _c_freeing( void* ptr ) noexcept
+{
+	if ( ptr == nullptr ) return;
+	size_t size = MemoryTracer::unknown_size;
+	if (_ready) [[likely]] size=memory_tracer->record_dealloc( ptr, alignof(std::max_align_t) );
+	_stats_dealloc(size);
+	if ( _events_open.load(std::memory_order_relaxed) ) [[unlikely]]
+	{
+		_events_write( EventStream::Op::dealloc, ptr, size, alignof(std::max_align_t), nullptr );
+	}
+}
+//The record is taken out before the block moves, so that the old address can't be reused (and
+//	recorded by another thread) while it still has a record.
+[[nodiscard]] static void* _c_realloc( void* ptr, size_t size, void const* call_site ) noexcept
+{
+	if ( ptr == nullptr )
+	{
+		void* result = _libc_malloc(size);
+		_c_alloced( result, alignof(std::max_align_t), size, call_site );
+		return result;
+	}
+	if ( size == 0 )
+	{
+		//Frees the block (C library permitting; if not, the result is a new one)
+		_c_freeing(ptr);
+		void* result = _libc_realloc( ptr, 0 );
+		_c_alloced( result, alignof(std::max_align_t), 0, call_site );
+		return result;
+	}
+
+	MemoryTracer::BlockInfo* block = _ready ? memory_tracer->_realloc_begin(ptr) : nullptr;
+	size_t old_size = block!=nullptr ? block->size : MemoryTracer::unknown_size;
+
+	void* result = _libc_realloc( ptr, size );
+
+	if (_ready) [[likely]] memory_tracer->_realloc_end( block, result, size, call_site );
+	if ( result != nullptr ) [[likely]]
+	{
+		_stats_dealloc(old_size);
+		_stats_alloc(size);
+		if ( _events_open.load(std::memory_order_relaxed) ) [[unlikely]]
+		{
+			_events_write( EventStream::Op::dealloc, ptr   , old_size, alignof(std::max_align_t), nullptr   );
+			_events_write( EventStream::Op::alloc  , result, size    , alignof(std::max_align_t), call_site );
+		}
+	}
+	return result;
+}
+#endif
+
+struct _EnsureMemoryTracer final
+{
+	_EnsureMemoryTracer()
+	{
+		memory_tracer = new MemoryTracer;
+		_ready = true;
+	}
+	~_EnsureMemoryTracer() noexcept
+	{
+		_ready = false;
+		delete memory_tracer;
+		memory_tracer = nullptr;
+	}
+};
+#ifdef __clang__
+	#pragma clang diagnostic push
+	#pragma clang diagnostic ignored "-Wexit-time-destructors"
+	#pragma clang diagnostic ignored "-Wglobal-constructors"
+#endif
+static _EnsureMemoryTracer _ensure_memory_tracer;
+#ifdef __clang__
+	#pragma clang diagnostic pop
+#endif
+#endif
+
+void prevent_linker_elison() {}
+
+}
+
+#ifdef TINYLEAKCHECK_ENABLED
+
+//Note: the new-expression only uses the aligned forms for alignments greater than the default, but
+//	they can also be called explicitly with smaller ones; backends handle both consistently.
+
+[[nodiscard]] void* operator new  ( std::size_t size                             )
+{
+	return TinyLeakCheck::_alloc_throwing(
+		__STDCPP_DEFAULT_NEW_ALIGNMENT__, size, TINYLEAKCHECK_RETURN_ADDRESS()
+	);
+}
+[[nodiscard]] void* operator new[]( std::size_t size                             )
+{
+	return TinyLeakCheck::_alloc_throwing(
+		__STDCPP_DEFAULT_NEW_ALIGNMENT__, size, TINYLEAKCHECK_RETURN_ADDRESS()
+	);
+}
+[[nodiscard]] void* operator new  ( std::size_t size, std::align_val_t alignment )
 {
-	TinyLeakCheck::_dealloc( __STDCPP_DEFAULT_NEW_ALIGNMENT__, ptr );
+	return TinyLeakCheck::_alloc_throwing(
+		static_cast<size_t>(alignment)  , size, TINYLEAKCHECK_RETURN_ADDRESS()
+	);
+}
+[[nodiscard]] void* operator new[]( std::size_t size, std::align_val_t alignment )
+{
+	return TinyLeakCheck::_alloc_throwing(
+		static_cast<size_t>(alignment)  , size, TINYLEAKCHECK_RETURN_ADDRESS()
+	);
+}
+
+[[nodiscard]] void* operator new  (
+	std::size_t size,                             std::nothrow_t const&
+) noexcept {
+	return TinyLeakCheck::_alloc_nothrow(
+		__STDCPP_DEFAULT_NEW_ALIGNMENT__, size, TINYLEAKCHECK_RETURN_ADDRESS()
+	);
+}
+[[nodiscard]] void* operator new[](
+	std::size_t size,                             std::nothrow_t const&
+) noexcept {
+	return TinyLeakCheck::_alloc_nothrow(
+		__STDCPP_DEFAULT_NEW_ALIGNMENT__, size, TINYLEAKCHECK_RETURN_ADDRESS()
+	);
+}
+[[nodiscard]] void* operator new  (
+	std::size_t size, std::align_val_t alignment, std::nothrow_t const&
+) noexcept {
+	return TinyLeakCheck::_alloc_nothrow(
+		static_cast<size_t>(alignment)  , size, TINYLEAKCHECK_RETURN_ADDRESS()
+	);
+}
+[[nodiscard]] void* operator new[](
+	std::size_t size, std::align_val_t alignment, std::nothrow_t const&
+) noexcept {
+	return TinyLeakCheck::_alloc_nothrow(
+		static_cast<size_t>(alignment)  , size, TINYLEAKCHECK_RETURN_ADDRESS()
+	);
+}
+
+void operator delete  ( void* ptr                                               ) noexcept
+{
+	TinyLeakCheck::_dealloc( __STDCPP_DEFAULT_NEW_ALIGNMENT__, ptr       );
+}
+void operator delete[]( void* ptr                                               ) noexcept
+{
+	TinyLeakCheck::_dealloc( __STDCPP_DEFAULT_NEW_ALIGNMENT__, ptr       );
+}
+void operator delete  ( void* ptr,                   std::align_val_t alignment ) noexcept
+{
+	TinyLeakCheck::_dealloc( static_cast<size_t>(alignment)  , ptr       );
+}
+void operator delete[]( void* ptr,                   std::align_val_t alignment ) noexcept
+{
+	TinyLeakCheck::_dealloc( static_cast<size_t>(alignment)  , ptr       );
+}
+
+void operator delete  ( void* ptr, std::size_t size                             ) noexcept
+{
+	TinyLeakCheck::_dealloc( __STDCPP_DEFAULT_NEW_ALIGNMENT__, ptr, size );
+}
+void operator delete[]( void* ptr, std::size_t size                             ) noexcept
+{
+	TinyLeakCheck::_dealloc( __STDCPP_DEFAULT_NEW_ALIGNMENT__, ptr, size );
+}
+void operator delete  ( void* ptr, std::size_t size, std::align_val_t alignment ) noexcept
+{
+	TinyLeakCheck::_dealloc( static_cast<size_t>(alignment)  , ptr, size );
+}
+void operator delete[]( void* ptr, std::size_t size, std::align_val_t alignment ) noexcept
+{
+	TinyLeakCheck::_dealloc( static_cast<size_t>(alignment)  , ptr, size );
+}
+
+void operator delete  ( void* ptr,                                               std::nothrow_t const& ) noexcept
+{
+	TinyLeakCheck::_dealloc( __STDCPP_DEFAULT_NEW_ALIGNMENT__, ptr       );
+}
+void operator delete[]( void* ptr,                                               std::nothrow_t const& ) noexcept
+{
+	TinyLeakCheck::_dealloc( __STDCPP_DEFAULT_NEW_ALIGNMENT__, ptr       );
+}
+void operator delete  ( void* ptr,                   std::align_val_t alignment, std::nothrow_t const& ) noexcept
+{
+	TinyLeakCheck::_dealloc( static_cast<size_t>(alignment)  , ptr       );
+}
+void operator delete[]( void* ptr,                   std::align_val_t alignment, std::nothrow_t const& ) noexcept
+{
+	TinyLeakCheck::_dealloc( static_cast<size_t>(alignment)  , ptr       );
+}
+
+#endif
+
+#ifdef TINYLEAKCHECK_PRELOAD
+
+/*
+C allocation functions, when preloaded.  These interpose on the C library's (whose memory they
+still hand out), and record blocks like `operator new` / `delete` above.  Together with those, they
+trace an unmodified program, e.g.:
+	LD_PRELOAD=./libtinyleakcheck_preload.so ./program
+Aligned blocks from these can be freed by plain `free(⋯)`, so they're all recorded alike.
+*/
+
+void* malloc( std::size_t size ) noexcept
+{
+	void* result = TinyLeakCheck::_libc_malloc(size);
+	TinyLeakCheck::_c_alloced( result, alignof(std::max_align_t), size, TINYLEAKCHECK_RETURN_ADDRESS() );
+	return result;
+}
+void* calloc( std::size_t count, std::size_t size ) noexcept
+{
+	void* result = TinyLeakCheck::_libc_calloc( count, size );
+	TinyLeakCheck::_c_alloced( result, alignof(std::max_align_t), count*size, TINYLEAKCHECK_RETURN_ADDRESS() );
+	return result;
+}
+void* realloc( void* ptr, std::size_t size ) noexcept
+{
+	return TinyLeakCheck::_c_realloc( ptr, size, TINYLEAKCHECK_RETURN_ADDRESS() );
+}
+void free( void* ptr ) noexcept
+{
+	TinyLeakCheck::_c_freeing(ptr);
+	TinyLeakCheck::_libc_free(ptr);
+}
+
+int posix_memalign( void** result, std::size_t alignment, std::size_t size ) noexcept
+{
+	int error = TinyLeakCheck::_libc_posix_memalign( result, alignment, size );
+	if ( error == 0 ) TinyLeakCheck::_c_alloced( *result, alignment, size, TINYLEAKCHECK_RETURN_ADDRESS() );
+	return error;
 }
-void operator delete( void* ptr, std::align_val_t alignment ) noexcept
+void* aligned_alloc( std::size_t alignment, std::size_t size ) noexcept
 {
-	TinyLeakCheck::_dealloc( static_cast<size_t>(alignment)  , ptr );
+	void* result = TinyLeakCheck::_libc_aligned_alloc( alignment, size );
+	TinyLeakCheck::_c_alloced( result, alignment, size, TINYLEAKCHECK_RETURN_ADDRESS() );
+	return result;
+}
+extern "C" void* memalign( std::size_t alignment, std::size_t size ) noexcept
+{
+	void* result = TinyLeakCheck::_libc_memalign( alignment, size );
+	TinyLeakCheck::_c_alloced( result, alignment, size, TINYLEAKCHECK_RETURN_ADDRESS() );
+	return result;
 }
 
 #endif
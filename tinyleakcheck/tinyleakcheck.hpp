@@ -29,17 +29,81 @@ User can `#define` any of the following to configure:
 
 	#define TINYLEAKCHECK_NO_RECORD_ALLOCS_BY_DEFAULT
 		Makes allocations not be recorded by default (presumably, you will push/pop
-		`TinyLakeCheck::memory_tracer.mode.record` when you are ready to record stuff later).
+		`TinyLakeCheck::memory_tracer->mode.record` when you are ready to record stuff later).  Note
+		that the mode is per-thread, so this applies to each new thread too.
 
 	#define TINYLEAKCHECK_NO_STACK_TRACE_BY_DEFAULT
 		For a recorded allocation, makes stack traced not be recorded by default.  (Similarly, you
-		can change `TinyLakeCheck::memory_tracer.mode.with_stacktrace` to enable/disable later.)
+		can change `TinyLakeCheck::memory_tracer->mode.with_stacktrace` to enable/disable later.)
+
+	#define TINYLEAKCHECK_POLICY ⟨type⟩
+	#define TINYLEAKCHECK_POLICY_HEADER ⟨header name⟩
+		Policy the tracer is compiled with (see `TinyLeakCheck::DefaultPolicy`, which is the default,
+		and which follows the macros above), and optionally a header to include that defines it
+		(within `namespace TinyLeakCheck`, right after `DefaultPolicy`).
+		The policy chooses, e.g., how stack traces are captured and whether statistics are kept,
+		with the features it leaves out compiled out of the allocation path entirely.  Note that
+		these must be `#define`d the same everywhere "tinyleakcheck.hpp" is included, and when the
+		"tinyleakcheck.cpp" file is compiled!
+
+	#define TINYLEAKCHECK_SAMPLING_INTERVAL ⟨integer⟩
+		Initial value for `TinyLeakCheck::memory_tracer->set_sampling_interval(⋯)`: the mean number
+		of bytes allocated between recorded allocations.  Zero (the default) records every
+		allocation.  Sampling makes the tracer cheap enough to leave on in production; reported
+		counts and sizes are then statistical estimates.
+
+	#define TINYLEAKCHECK_MEMORY_BUDGET ⟨integer⟩
+		Initial value for `TinyLeakCheck::memory_tracer->set_memory_budget(⋯)`: the most bytes the
+		tracer should use for its own records and stack traces.  Zero (the default) is unlimited.
+		The environment variable of the same name overrides this at startup.
+
+	#define TINYLEAKCHECK_INBAND_HEADER
+		Places a small header in front of every block allocated through `operator new`, holding a
+		magic tag, the size and alignment, and the index of the block's record.  Deallocation then
+		goes straight to the record instead of searching for it, and freeing a pointer twice (or one
+		that `operator new` never returned) is caught by the tag.  Costs a few bytes per allocation.
+		Note that this must have been `#define`d when the "tinyleakcheck.cpp" file is compiled in
+		order to have an effect!
+
+	#define TINYLEAKCHECK_PRELOAD
+		Builds "tinyleakcheck.cpp" as a library to be `LD_PRELOAD`ed into an unmodified program (the
+		"tinyleakcheck_preload" target; Linux only).  Besides `operator new` / `delete`, it then also
+		replaces `malloc(⋯)`, `calloc(⋯)`, `realloc(⋯)`, `free(⋯)`, and the aligned variants,
+		forwarding to the C library's.  A `realloc(⋯)`ed block keeps its record (and so the stack
+		trace of its original allocation).  The default `.leaks_detected(⋯)` then only reports leaks,
+		rather than trapping and aborting, so the program exits as it would have.  TinyLeakCheck must
+		be enabled (see `TINYLEAKCHECK_WHEN_ENABLED`).
+
+		Note that the tracer is created by an ordinary static initializer of the library, which runs
+		after the dynamic loader has started up, and after the static initializers of the program's
+		other libraries that the preloaded one doesn't depend on.  Allocations made before then are
+		not recorded (freeing them later is just ignored), so leaks among them are not reported.
+
+	#define TINYLEAKCHECK_BACKEND ⟨string literal⟩
+		Name of the allocator underneath the tracer: "malloc" (the default; `malloc(⋯)`, padded out
+		for larger alignments), "memalign" (`posix_memalign(⋯)`, or `_aligned_malloc(⋯)` on
+		Windows), or "sizeclass" (a built-in thread-caching size-class allocator).  The environment
+		variable of the same name overrides this at startup.  Note that this must have been
+		`#define`d when the "tinyleakcheck.cpp" file is compiled in order to have an effect!
+
+	#define TINYLEAKCHECK_CUSTOM_BACKEND ⟨identifier⟩
+		Name of a global `extern constinit TinyLeakCheck::Backend const` object that you define (e.g.
+		wrapping your own arena allocator).  It can then be selected by its `.name` like the
+		built-in backends, and is the default unless `TINYLEAKCHECK_BACKEND` is also `#define`d.
+
+	#define TINYLEAKCHECK_BACKGROUND_SYMBOLIZER ⟨interval in milliseconds⟩
+		Starts `TinyLeakCheck::MemoryTracer::start_background_symbolizer(⋯)` along with the tracer,
+		so that stack frames of long-lived blocks are symbolized while the program runs, instead of
+		all at once when reporting at exit (which for a big process can take long enough to be
+		killed by whatever is shutting it down).  Note that this must have been `#define`d when the
+		"tinyleakcheck.cpp" file is compiled in order to have an effect!
 
 	#define TINYLEAKCHECK_PRETTIFY_STRS ⟨brace initializer of array of pairs of strings⟩
 		Defines an array of (find,replace) pairs to be used internally for prettifying function
-		names.  Note that actual `std::string`s can be used here without issue, if you prefer.  Also
-		note that this must have been `#define`d when the "tinyleakcheck.cpp" file is compiled in
-		order to have an effect!
+		names.  Note that actual `std::string`s can be used here without issue, if you prefer.  All
+		pairs are applied together in one pass (leftmost-longest match first, and the text is
+		matched as it is rewritten), so their order doesn't matter.  Also note that this must have
+		been `#define`d when the "tinyleakcheck.cpp" file is compiled in order to have an effect!
 
 	#define TINYLEAKCHECK_PRETTIFY_ENVS ⟨brace initializer of array of env. variables⟩
 		Defines an array of environment variables to be searched for prettifying filenames.  If the
@@ -53,13 +117,44 @@ User can `#define` any of the following to configure:
 		certain memory allocations within the standard library that are cleaned up after static
 		destruction (such an allocation would be falsely reported as a memory leak).  Note that this
 		should *only* be used for ignoring functions in standard libraries; do *not* use this
-		instead of fixing your code!
+		instead of fixing your code!  Allocations made directly from such a function are not
+		recorded at all (the verdict is made once per call site), so they cost almost nothing.
+
+	#define TINYLEAKCHECK_NO_IGNORE_AT_ALLOC
+		Records allocations from `TINYLEAKCHECK_IGNORE_FUNCS` like any other, and drops them only
+		when reporting at exit, instead of symbolizing each new call site as it first allocates.
+		Note that this must have been `#define`d when the "tinyleakcheck.cpp" file is compiled in
+		order to have an effect!
 
 	#define TINYLEAKCHECK_ASSERT ⟨assert⟩
 		Defines an assertion function for TinyLeakCheck to use internally.  If none is provided, it
 		uses `<cassert>`'s assert.  Note that this must be `#define`d when the "tinyleakcheck.cpp"
 		file is compiled in order to have (complete) effect!
 
+	#define TINYLEAKCHECK_MAX_FRAMES ⟨integer⟩
+		Maximum number of frames kept in a stack trace (default 32).  Traces are stored inline as
+		raw return addresses and are only symbolized when printed, so this bounds both the memory
+		per block and the cost of capturing the trace.
+
+	#define TINYLEAKCHECK_UNWIND_FRAME_POINTERS
+		Capture stack traces by walking the frame-pointer chain, which is much faster than the
+		default unwinder but only works if *all* code was compiled with frame pointers (e.g.
+		`-fno-omit-frame-pointer`); a frame without one ends the trace early.  Not on Windows.
+
+	#define TINYLEAKCHECK_UNWIND_STD_STACKTRACE
+		Capture stack traces with `std::stacktrace::current(⋯)` instead of the platform's own
+		unwinder (`_Unwind_Backtrace(⋯)` or `RtlCaptureStackBackTrace(⋯)`).  Slowest option.
+
+	#define TINYLEAKCHECK_REGISTRY_SHARDS ⟨power of two⟩
+		Number of independently locked shards the block registry is split into (default 64).  More
+		shards means less contention between threads allocating concurrently, at the cost of a
+		cache line or so of memory each.
+
+	#define TINYLEAKCHECK_THREAD_LOG_SIZE ⟨integer⟩
+		Capacity of each thread's log of recently allocated blocks (default 64).  Blocks sit in
+		this log until it overflows (or the thread exits, or the tracer is flushed), and a block
+		that is freed by the same thread while still in the log never touches the shared registry.
+
 ####################################################################################################
 */
 
@@ -80,7 +175,14 @@ User can `#define` any of the following to configure:
 		{ "VS2019INSTALLDIR" }
 #endif
 #ifndef TINYLEAKCHECK_IGNORE_STDLIB_FUNCS
-	#define TINYLEAKCHECK_IGNORE_FUNCS { "std::use_facet", "std::_Facet_Register" }
+	#ifdef TINYLEAKCHECK_PRELOAD
+		//(The C library's stdio buffers, and the TLS of threads whose stacks it caches, also outlive
+		//	the tracer.)
+		#define TINYLEAKCHECK_IGNORE_FUNCS\
+			{ "std::use_facet", "std::_Facet_Register", "_IO_file_doallocate", "_dl_allocate_tls" }
+	#else
+		#define TINYLEAKCHECK_IGNORE_FUNCS { "std::use_facet", "std::_Facet_Register" }
+	#endif
 #endif
 #ifndef TINYLEAKCHECK_ASSERT
 	#include <cassert>
@@ -104,13 +206,36 @@ User can `#define` any of the following to configure:
 
 #define TINYLEAKCHECK_PUSHABLE_DEPTH 8
 
+#ifndef TINYLEAKCHECK_POLICY
+	#define TINYLEAKCHECK_POLICY DefaultPolicy
+#endif
+
+#ifndef TINYLEAKCHECK_SAMPLING_INTERVAL
+	#define TINYLEAKCHECK_SAMPLING_INTERVAL 0
+#endif
+#ifndef TINYLEAKCHECK_MEMORY_BUDGET
+	#define TINYLEAKCHECK_MEMORY_BUDGET 0
+#endif
+#ifndef TINYLEAKCHECK_MAX_FRAMES
+	#define TINYLEAKCHECK_MAX_FRAMES 32
+#endif
+#ifndef TINYLEAKCHECK_REGISTRY_SHARDS
+	#define TINYLEAKCHECK_REGISTRY_SHARDS 64
+#endif
+#ifndef TINYLEAKCHECK_THREAD_LOG_SIZE
+	#define TINYLEAKCHECK_THREAD_LOG_SIZE 64
+#endif
+
 #include <cstdarg>
+#include <cstdint>
+#include <cstdio>
 #include <array>
-#include <deque>
-#include <map>
-#include <stacktrace>
+#include <atomic>
+#include <mutex>
+#include <span>
 #include <string>
 #include <thread>
+#include <vector>
 
 
 
@@ -180,98 +305,775 @@ class ArrayStack final
 
 
 
-#ifdef TINYLEAKCHECK_ENABLED
-//Memory tracer.  User does not need directly.
-struct MemoryTracer final
+//A stack trace, stored inline as raw return addresses (innermost first).  Capturing one is cheap;
+//	the frames are only symbolized when `.symbolize(⋯)` is called on them.  Call `::current()`
+//	anywhere to record the current stack.
+class StackTrace final
 {
-	struct Mode final
+	public:
+		static constexpr std::size_t max_frames = TINYLEAKCHECK_MAX_FRAMES;
+
+		struct Symbol final
+		{
+			std::string description; //Function name (empty if unknown)
+			std::string source_file; //(empty if unknown)
+			std::uint_least32_t source_line = 0; //(zero if unknown)
+		};
+
+	private:
+		std::uint32_t _count = 0;
+		std::array< void*, max_frames > _frames;
+
+	public:
+		StackTrace() noexcept = default;
+
+		//Captures the calling thread's stack.  If `call_site` is given, frames inside the callee
+		//	are dropped: the trace starts at the frame which returns to `call_site` (e.g. pass the
+		//	return address of an allocation function to make the trace start at its caller).
+		//	Otherwise, the trace starts at the caller of `::current(⋯)`.
+		[[nodiscard]] static StackTrace current( void const* call_site=nullptr ) noexcept;
+		//Just the one frame `call_site`, without unwinding (e.g. to tell allocation sites apart
+		//	more cheaply than by their whole stacks).
+		[[nodiscard]] static StackTrace of_call_site( void const* call_site ) noexcept;
+
+		[[nodiscard]] constexpr bool        empty() const noexcept { return _count==0; }
+		[[nodiscard]] constexpr std::size_t size () const noexcept { return _count; }
+
+		[[nodiscard]] void* operator[]( std::size_t index ) const noexcept
+		{
+			TINYLEAKCHECK_ASSERT( index<_count, "Index %zu out of bound!", index );
+			return _frames[index];
+		}
+		[[nodiscard]] void* const* begin() const noexcept { return _frames.data()         ; }
+		[[nodiscard]] void* const* end  () const noexcept { return _frames.data() + _count; }
+
+		//Looks up the function and source location of a return address.  This is slow.
+		[[nodiscard]] static Symbol symbolize( void const* return_address );
+};
+
+//Global table of interned stack traces.  Identical traces (e.g. from every iteration of a loop) are
+//	stored only once, and are named by a 32-bit id, zero meaning "no trace".  Traces are never
+//	removed.
+class StackDepot final
+{
+	public:
+		using Id = std::uint32_t;
+
+		//Returns the id of the given trace, adding it if it is new.  Returns zero for an empty
+		//	trace (or if the depot is full).
+		[[nodiscard]] static Id intern( StackTrace const& trace ) noexcept;
+
+		//The frames of an interned trace (empty for id zero).  Lock-free.
+		[[nodiscard]] static std::span< void* const > get( Id id ) noexcept;
+
+		//Number of distinct traces interned so far.
+		[[nodiscard]] static std::size_t size() noexcept;
+};
+
+
+
+//Format of the binary event stream (see `MemoryTracer::open_event_stream(⋯)`).  Each thread writes
+//	fixed-size records into a ring in its own memory-mapped file, named
+//	"tinyleakcheck.⟨pid⟩.⟨thread index⟩.events" (a ring is handed on to a new thread once its thread
+//	exits, and past a limit, threads share ring zero); these are read offline by the analyzer
+//	("tools/analyze.cpp"), along with "tinyleakcheck.⟨pid⟩.maps".  Files are in the writing
+//	machine's byte order.
+struct EventStream final
+{
+	static constexpr char magic[8] = { 'T','L','C','E','V','N','T','1' };
+	static constexpr std::uint32_t version = 1;
+	static constexpr std::size_t max_frames = 16;
+
+	enum class Op : std::uint8_t { alloc=1, dealloc=2 };
+
+	struct FileHeader final
 	{
-		//Whether we are tracing memory
-		ArrayStack< bool, TINYLEAKCHECK_PUSHABLE_DEPTH > record;
-		//Whether a stack trace should be recorded also.
-		ArrayStack< bool, TINYLEAKCHECK_PUSHABLE_DEPTH > with_stacktrace;
-
-		Mode() :
-			#ifndef TINYLEAKCHECK_NO_RECORD_ALLOCS_BY_DEFAULT
-			record(true ),
-			#else
-			record(false),
-			#endif
-			#ifndef TINYLEAKCHECK_NO_STACK_TRACE_BY_DEFAULT
-			with_stacktrace(true )
-			#else
-			with_stacktrace(false)
-			#endif
-		{}
+		char magic[8];
+		std::uint32_t version;
+		std::uint32_t record_size;
+		std::uint64_t capacity; //Number of records in the ring
+		//Number of records ever written; record `k` is at `k % capacity`, so if this exceeds the
+		//	capacity, the oldest records have been overwritten.
+		std::atomic<std::uint64_t> written;
+		std::uint32_t pid;
+		std::uint32_t thread_index; //Of the ring (zero is shared by threads that have none of their own)
+		std::uint8_t reserved[ 24 ];
 	};
-	Mode mode;
+	static_assert( sizeof(FileHeader) == 64 );
 
-	//Represents a memory block.
+	struct Record final
+	{
+		std::uint64_t timestamp; //Nanoseconds, of `std::chrono::steady_clock`
+		std::uint64_t ptr;
+		std::uint64_t size;      //(`~0` if unknown, for deallocations)
+		std::uint32_t alignment;
+		std::uint32_t thread_index;
+		Op op;
+		std::uint8_t frame_count;
+		std::uint8_t reserved[ 6 ];
+		std::uint64_t frames[ max_frames ]; //Raw return addresses, innermost first (allocations only)
+	};
+	static_assert( sizeof(Record) == 168 );
+};
+
+
+
+#ifdef TINYLEAKCHECK_ENABLED
+struct _ThreadLog;
+
+//The parts of the memory tracer that don't depend on its policy (see `BasicMemoryTracer`).
+struct MemoryTracerBase
+{
+	//Global override of every thread's `.mode`, e.g. to stop recording everywhere at once.  With
+	//	`Override::none` (the default), each thread's own `.mode` applies.
+	enum class Override : std::uint8_t { none=0, off=1, on=2 };
+	void set_override( Override record, Override with_stacktrace ) noexcept;
+	std::atomic<std::uint8_t> _override; //Record override in the low two bits, stack traces' above
+	std::atomic<bool> _unrecorded_ever; //If so, unknown pointers may just not have been recorded
+
+	class BlockRegistry;
+
+	//Represents a memory block.  These live in a dedicated pool (see "tinyleakcheck.cpp"), not on
+	//	the traced heap.
 	class BlockInfo final
 	{
-		friend struct MemoryTracer;
+		friend struct MemoryTracerBase;
+		template< class PolicyType > friend struct BasicMemoryTracer;
+		friend class BlockRegistry;
+		friend class _BlockPool;
+		friend struct _ThreadLog;
 		public:
 			void* ptr;
 			size_t alignment, size;
 			std::thread::id thread_id;
-			std::stacktrace trace;
+			StackDepot::Id stack_id; //Trace starting at the allocation's call site (or zero)
+			float weight = 1.0f; //Number of allocations this one represents, when sampling
+			std::uint64_t generation; //Tracer's generation (see `.snapshot()`) when recorded
+			std::uint64_t epoch;      //Application's epoch (see `.advance_epoch()`) when recorded
+			std::uint64_t timestamp = 0; //Steady-clock time (ns) when recorded (see `.collect_churn()`)
 		private:
-			bool mutable _finalized = false;
-			std::string mutable _str;
+			BlockInfo*  _next = nullptr; //Intrusive chain within a `BlockRegistry` bucket . . .
+			BlockInfo** _link;           //	. . . and the link pointing to this block, for unlinking
+			//Likewise, for a `BlockRegistry` shard's lists of blocks by epoch and by generation
+			struct _AgeLink final
+			{
+				BlockInfo*  next;
+				BlockInfo** link;
+			};
+			_AgeLink _by_epoch, _by_generation;
+			std::uint32_t _slot;        //Index of this record within the pool
+			std::atomic<_ThreadLog*> _log = nullptr; //Log the block is pending in, if any
 
 		private:
-			BlockInfo( void* ptr, size_t alignment,size_t size, bool with_stacktrace ) noexcept;
-
-			[[nodiscard]] bool _finalize() const noexcept; //Returns whether block isn't ignored.
+			BlockInfo(
+				void* ptr, size_t alignment,size_t size,
+				bool with_stacktrace, void const* call_site
+			) noexcept;
 
 		public:
 			void basic_print( FILE* file=stderr ) const noexcept;
 	};
-	//Map of pointers onto blocks.  User should not change, but is exposed to user.
-	std::map< void*, BlockInfo* > blocks;
+
+	//Blocks grouped by the stack they were allocated from.
+	struct Site final
+	{
+		static constexpr std::size_t max_samples = 4;
+
+		StackDepot::Id stack_id;
+		std::size_t count = 0; //Number of blocks
+		std::size_t bytes = 0; //Total size of blocks
+		std::array< void*, max_samples > samples; //Addresses of the first few blocks
+		std::size_t sample_count = 0; //Number of valid `.samples`
+
+		//When sampling, unbiased estimates of the true number and size of blocks represented.
+		//	(Otherwise, the same as `.count` and `.bytes`.)
+		double estimated_count = 0.0;
+		double estimated_bytes = 0.0;
+
+		void basic_print( FILE* file=stderr ) const noexcept;
+		//Appends what `.basic_print(⋯)` prints to `str`.
+		void basic_format( std::string* str ) const;
+	};
+
+	//While an instance exists, allocations on the constructing thread are not recorded.  Used
+	//	internally so that the tracer's own allocations (and those of callbacks) don't recurse.
+	class InternalScope final
+	{
+		private:
+			bool _was_internal;
+		public:
+			InternalScope() noexcept;
+			~InternalScope() noexcept;
+			InternalScope( InternalScope const& ) = delete;
+			InternalScope& operator=( InternalScope const& ) = delete;
+	};
+
+	//Concurrent map of pointers onto blocks.  It is split into shards by pointer hash, each with
+	//	its own lock and chained hash table (bucket arrays come from raw `calloc(⋯)`, and chains
+	//	are threaded through the blocks themselves, so the registry never allocates through the
+	//	traced `operator new`).
+	class BlockRegistry final
+	{
+		static_assert(
+			TINYLEAKCHECK_REGISTRY_SHARDS>0 &&
+			(TINYLEAKCHECK_REGISTRY_SHARDS&(TINYLEAKCHECK_REGISTRY_SHARDS-1))==0,
+			"Shard count must be a power of two!"
+		);
+
+		private:
+			//Besides the hash table, each shard lists its blocks by age: by the epoch they were
+			//	recorded in, and by the generation (see `.snapshot()`).  Each of the most recent
+			//	`age_ring` ages has its own list, and blocks from before then share one.  A query
+			//	for old blocks then only walks the lists of old epochs, and one for the blocks of
+			//	a few recent generations only the lists of those.
+			static constexpr std::uint64_t age_ring = 16;
+			struct AgeLists final
+			{
+				std::uint64_t newest = 0;
+				BlockInfo* recent[ age_ring ] = {}; //Age `a` at `a % age_ring`
+				BlockInfo* ancient = nullptr;       //Ages `newest - age_ring` and before
+			};
+			using AgeLink = BlockInfo::_AgeLink BlockInfo::*;
+			using AgeOf   = std::uint64_t       BlockInfo::*;
+			struct alignas(64) Shard final
+			{
+				std::mutex mutable mutex;
+				BlockInfo** buckets = nullptr;
+				std::size_t bucket_count = 0; //Power of two (or zero)
+				std::size_t count = 0;
+
+				AgeLists epochs, generations;
+			};
+			std::array< Shard, TINYLEAKCHECK_REGISTRY_SHARDS > _shards;
+
+			//Held by the walks below.  Besides not recording allocations, the calling thread then
+			//	leaves records alone when it frees their blocks, since it may be holding the very
+			//	shard the record is in (or, for the in-band case, one a log's publisher is waiting on).
+			class _WalkScope final
+			{
+				private:
+					InternalScope _internal;
+				public:
+					_WalkScope() noexcept;
+					~_WalkScope() noexcept;
+			};
+
+		public:
+			BlockRegistry() noexcept = default;
+			~BlockRegistry() noexcept; //Frees the tables, but not any blocks still in them
+			BlockRegistry( BlockRegistry const& ) = delete;
+			BlockRegistry& operator=( BlockRegistry const& ) = delete;
+
+		private:
+			[[nodiscard]] static std::uint64_t _hash( void const* ptr ) noexcept;
+			[[nodiscard]] Shard      & _shard_for( std::uint64_t hash )       noexcept;
+			static void _grow( Shard* shard ) noexcept;
+			static void _insert_locked( Shard* shard, std::uint64_t hash, BlockInfo* block ) noexcept;
+			static void _unlink_locked( Shard* shard, BlockInfo* block ) noexcept
+			{
+				*block->_link = block->_next;
+				if ( block->_next != nullptr ) block->_next->_link=block->_link;
+				--shard->count;
+				_unlink_ages(block);
+			}
+			static void _advance_ages( AgeLists* lists, AgeLink by, std::uint64_t age ) noexcept;
+			static void _link_age( AgeLists* lists, AgeLink by, BlockInfo* block, std::uint64_t age ) noexcept;
+			static void _unlink_age( BlockInfo* block, AgeLink by ) noexcept
+			{
+				BlockInfo::_AgeLink& self = block->*by;
+				*self.link = self.next;
+				if ( self.next != nullptr ) (self.next->*by).link=self.link;
+			}
+			static void _link_ages( Shard* shard, BlockInfo* block ) noexcept
+			{
+				_link_age( &shard->epochs,      &BlockInfo::_by_epoch,      block, block->epoch      );
+				_link_age( &shard->generations, &BlockInfo::_by_generation, block, block->generation );
+			}
+			static void _unlink_ages( BlockInfo* block ) noexcept
+			{
+				_unlink_age( block, &BlockInfo::_by_epoch      );
+				_unlink_age( block, &BlockInfo::_by_generation );
+			}
+			//Calls `fn(block)` for the blocks in `lists` whose age is in [`first`,`last`], only
+			//	walking the lists that can have them.
+			template< class Fn > static void _walk_ages(
+				AgeLists const& lists, AgeLink by, AgeOf age_of,
+				std::uint64_t first, std::uint64_t last, Fn&& fn
+			) {
+				auto walk = [&]( BlockInfo const* block )
+				{
+					for ( ; block!=nullptr; block=(block->*by).next )
+					{
+						if ( block->*age_of>=first && block->*age_of<=last ) fn( *block );
+					}
+				};
+				std::uint64_t oldest_recent = lists.newest>=age_ring ? lists.newest-age_ring+1 : 0;
+				if ( first < oldest_recent ) walk( lists.ancient );
+				for (
+					std::uint64_t age = first>oldest_recent ? first : oldest_recent;
+					age<=last && age<=lists.newest;
+					++age
+				) {
+					walk( lists.recent[ age % age_ring ] );
+				}
+			}
+
+		public:
+			//Adds a block, keyed by its `.ptr`.
+			void insert( BlockInfo* block ) noexcept;
+			//Adds several blocks, taking each shard's lock only once.
+			void insert_batch( BlockInfo* const* blocks, std::size_t count ) noexcept;
+			//Removes and returns the block for the given pointer, or `nullptr` if there is none.
+			[[nodiscard]] BlockInfo* extract( void const* ptr ) noexcept;
+			//Removes a block known to be here, without searching for it.
+			void unlink( BlockInfo* block ) noexcept;
+
+			[[nodiscard]] std::size_t size () const noexcept;
+			[[nodiscard]] bool        empty() const noexcept { return size() == 0; }
+
+			//Calls `fn(block)` for every block.  Each shard is locked while it is visited, so other
+			//	threads may keep allocating meanwhile, and recording is disabled on this thread
+			//	during the walk.  Recorded blocks freed by `fn(⋯)` itself keep their records (and so
+			//	will be reported as leaked), since the registry can't be changed mid-walk.
+			template< class Fn > void for_each( Fn&& fn ) const
+			{
+				_WalkScope walk;
+				for ( Shard const& shard : _shards )
+				{
+					std::lock_guard lock_raii(shard.mutex);
+					for ( std::size_t k=0; k<shard.bucket_count; ++k )
+					{
+						for ( BlockInfo const* block=shard.buckets[k]; block!=nullptr; block=block->_next )
+						{
+							fn( *block );
+						}
+					}
+				}
+			}
+			//Calls `fn(block)` for every block recorded in epoch `max_epoch` or earlier.  As for
+			//	`.for_each(⋯)`, except that only the lists of those epochs are walked.
+			template< class Fn > void for_each_until_epoch( std::uint64_t max_epoch, Fn&& fn ) const
+			{
+				_WalkScope walk;
+				for ( Shard const& shard : _shards )
+				{
+					std::lock_guard lock_raii(shard.mutex);
+					_walk_ages( shard.epochs, &BlockInfo::_by_epoch, &BlockInfo::epoch, 0,max_epoch, fn );
+				}
+			}
+			//Calls `fn(block)` for every block recorded in generations [`first`,`last`].  Likewise,
+			//	only the lists of those generations are walked (and, if `first` is more than
+			//	`age_ring` generations ago, that of older blocks).
+			template< class Fn > void for_each_in_generations(
+				std::uint64_t first, std::uint64_t last, Fn&& fn
+			) const {
+				_WalkScope walk;
+				for ( Shard const& shard : _shards )
+				{
+					std::lock_guard lock_raii(shard.mutex);
+					_walk_ages(
+						shard.generations, &BlockInfo::_by_generation, &BlockInfo::generation,
+						first,last, fn
+					);
+				}
+			}
+			//Calls `fn(block)` for every block, and unlinks the block if `fn(⋯)` returns true (in
+			//	which case `fn(⋯)` has taken ownership of it).  Locking is as for `.for_each(⋯)`.
+			template< class Fn > void extract_if( Fn&& fn )
+			{
+				_WalkScope walk;
+				for ( Shard& shard : _shards )
+				{
+					std::lock_guard lock_raii(shard.mutex);
+					for ( std::size_t k=0; k<shard.bucket_count; ++k )
+					{
+						for ( BlockInfo** link=shard.buckets+k; *link!=nullptr; )
+						{
+							BlockInfo* block = *link;
+							BlockInfo* next  = block->_next;
+							_unlink_ages(block); //(Before `fn(⋯)` might take it)
+							if ( fn(block) )
+							{
+								*link = next;
+								if ( next != nullptr ) next->_link=link;
+								--shard.count;
+							}
+							else
+							{
+								_link_ages( &shard, block ); //Put it back
+								link = &block->_next;
+							}
+						}
+					}
+				}
+			}
+	};
+	//Map of pointers onto blocks.  User should not change, but is exposed to user.  Note that
+	//	recently allocated blocks may still be pending in their thread's log; call `.flush()`
+	//	first if you need to see all of them.
+	BlockRegistry blocks;
+
+	//Groups the current `.blocks` by allocation stack, largest total first.  (Like walking
+	//	`.blocks`, does not include blocks pending in per-thread logs; `.flush()` first.)
+	[[nodiscard]] std::vector<Site> collect_sites() const;
+
+	//Epochs.  The application advances the epoch whenever it likes (e.g. once per batch of requests,
+	//	or once per minute), and blocks remember the epoch they were recorded in.  Then blocks
+	//	that are still alive many epochs later are likely growth or leaks, which can be found
+	//	without waiting for the program to exit.
+	std::uint64_t advance_epoch() noexcept //Returns the new epoch
+	{
+		return _epoch.fetch_add( 1, std::memory_order_relaxed ) + 1;
+	}
+	[[nodiscard]] std::uint64_t get_epoch() const noexcept
+	{
+		return _epoch.load(std::memory_order_relaxed);
+	}
+	std::atomic<std::uint64_t> _epoch;
+	//Groups the live blocks recorded at least `age` epochs ago (i.e. in epoch `.get_epoch()-age` or
+	//	before) by allocation stack, largest total first.  Flushes first, and only walks the
+	//	registry's lists of those old epochs.
+	[[nodiscard]] std::vector<Site> collect_sites_older_than( std::uint64_t age );
+
+	//Snapshots, for finding growth in long-running programs (which may never report leaks at exit).
+	//	Live totals are kept per site as blocks are recorded and retired, so a snapshot costs time
+	//	proportional to the number of distinct sites rather than blocks, and never stops other
+	//	threads.  Each snapshot also starts a new generation, which blocks record when allocated.
+	struct Snapshot final
+	{
+		struct Entry final
+		{
+			StackDepot::Id stack_id;
+			std::int64_t count, bytes;
+			double estimated_count, estimated_bytes;
+		};
+		std::uint64_t generation; //Blocks recorded after the snapshot have at least this generation
+		std::vector<Entry> sites; //Sites with live blocks, by increasing stack id
+	};
+	[[nodiscard]] Snapshot snapshot() noexcept;
+	//Sites whose live totals grew from `before` to `after` (as `.count` / `.bytes`), largest growth
+	//	first.  The samples are blocks recorded in between that are still live; finding them only
+	//	walks the registry's lists of the generations in between (see `.blocks`), so it costs time
+	//	proportional to those blocks, as long as `before` is one of the last 16 snapshots.
+	[[nodiscard]] std::vector<Site> diff( Snapshot const& before, Snapshot const& after );
+	std::atomic<std::uint64_t> _generation;
+
+	//Writes the live heap, aggregated by allocation stack, in the legacy text heap-profile format
+	//	of gperftools (which `pprof`, and flame-graph tools built on it, can read).  This uses the
+	//	live totals kept per site, so it costs time proportional to the number of sites, not blocks.
+	void write_heap_profile( FILE* file );
+
+	//Allocation churn.  When its policy keeps lifetimes (see `DefaultPolicy`), the tracer counts
+	//	the blocks recorded at each site, and when a block is freed, puts its lifetime into a log-
+	//	scale histogram of its site.  Short-lived blocks from a busy site are the ones worth pooling
+	//	or eliminating.  (When sampling, only the sampled blocks are counted.)
+	struct ChurnSite final
+	{
+		//Histogram bucket 0 counts lifetimes under 64 ns; bucket `k>0` those in
+		//	[ 2^(k+5), 2^(k+6) ) ns, except the last, which counts everything longer.
+		static constexpr std::size_t lifetime_buckets = 40;
+
+		StackDepot::Id stack_id;
+		std::uint64_t allocations = 0; //Blocks recorded, since the tracer was created
+		std::uint64_t frees       = 0; //Of those, how many were freed (i.e., in the histogram)
+		double allocation_rate    = 0.0; //Mean allocations per second, since the tracer was created
+		//Lifetime that half of the freed blocks didn't outlive, to within its bucket (the upper
+		//	bound is given), or zero if none were freed.
+		std::uint64_t median_lifetime_ns = 0;
+		std::array< std::uint64_t, lifetime_buckets > lifetimes = {};
+	};
+	//Sites that have recorded blocks, by most allocations first.  This costs time proportional to
+	//	the number of sites, not blocks.
+	[[nodiscard]] std::vector<ChurnSite> collect_churn() const;
+	//Writes the `top` sites by allocation rate, and the `top` sites by shortest median lifetime
+	//	(among those with at least `1/1000` of all allocations), with their histograms and stacks.
+	//	This is also written when the tracer is destroyed, if the environment variable
+	//	`TINYLEAKCHECK_CHURN_REPORT` is set: to the file it names, or to `stderr` for "-".
+	void write_churn_report( FILE* file=stderr, std::size_t top=10 ) const;
+
+	//Sampling.  With a nonzero interval, an allocation is only recorded when the bytes allocated by
+	//	its thread cross a randomized threshold, with mean `bytes` between thresholds (i.e. byte-
+	//	interval Poisson sampling).  A block of size `s` is then recorded with probability
+	//	`1-exp(-s/bytes)` and is weighted by the inverse, so that estimated totals stay unbiased.
+	//	Unrecorded allocations cost a thread-local decrement, and their deallocations are rejected
+	//	by a small filter, without looking at the registry.
+	void set_sampling_interval( std::size_t bytes ) noexcept;
+	[[nodiscard]] std::size_t get_sampling_interval() const noexcept
+	{
+		return _sampling_interval.load(std::memory_order_relaxed);
+	}
+	std::atomic<std::size_t> _sampling_interval;
+	std::atomic<bool> _sampled_ever; //If so, unknown pointers may just not have been sampled
+
+	//Size passed to, and returned from, `.record_dealloc(⋯)` and friends when it isn't known.
+	static constexpr size_t unknown_size = ~size_t(0);
+
+
+	//Statistics of all `operator new` / `delete` traffic (including the tracer's own), kept whether
+	//	or not allocations are being recorded.  Each thread updates its own counters without any
+	//	locking or atomic read-modify-writes, and `.get_stats()` sums them.  Freed bytes are only
+	//	known for sized deallocations, in-band headers, or recorded blocks; other frees are counted
+	//	in `.free_unknown_count`, and make `.live_bytes` an overestimate.  `.peak_bytes` is
+	//	approximate: live bytes are only combined across threads every 64 KiB or so of change.
+	struct Stats final
+	{
+		static constexpr std::size_t histogram_size = 65;
+
+		std::uint64_t alloc_count = 0;
+		std::uint64_t free_count = 0;
+		std::uint64_t free_unknown_count = 0;
+		std::uint64_t alloc_bytes = 0; //Cumulative
+		std::uint64_t free_bytes = 0;  //Cumulative
+		std::int64_t live_bytes = 0;
+		std::int64_t peak_bytes = 0;
+		std::uint64_t overhead_bytes = 0; //Tracer's own (see `.get_overhead_bytes()`)
+		//Allocations by size: `.histogram[k]` counts sizes in [2ᵏ⁻¹,2ᵏ) (and `[0]` size zero)
+		std::array< std::uint64_t, histogram_size > histogram = {};
+	};
+	[[nodiscard]] static Stats get_stats() noexcept;
+
+	//Memory budget.  The tracer's own long-lived memory (its records of blocks, interned stack
+	//	traces, and their tables; not the event stream's files) is accounted for as it's allocated.
+	//	With a nonzero budget, the tracer degrades as its overhead approaches it, so that tracing
+	//	never takes the process down.  From 7/8 of the budget, new blocks are recorded with just
+	//	their call site instead of their whole stack.  From the budget on, new blocks aren't
+	//	recorded at all, but folded into per-call-site counts of allocations and bytes (see
+	//	`.collect_folded_sites()`); whether those are ever freed is unknown, so they can't be
+	//	reported as leaks.  Records are recycled but not returned, so the overhead doesn't shrink
+	//	as blocks are freed; raising the budget resumes recording.
+	enum class Degradation : std::uint8_t { none=0, call_sites_only=1, folded=2 };
+	void set_memory_budget( std::size_t bytes ) noexcept;
+	[[nodiscard]] std::size_t get_memory_budget() const noexcept
+	{
+		return _memory_budget.load(std::memory_order_relaxed);
+	}
+	[[nodiscard]] Degradation get_degradation() const noexcept;
+	[[nodiscard]] static std::size_t get_overhead_bytes() noexcept;
+	std::atomic<std::size_t> _memory_budget;
+	//Allocations folded so far, grouped by call site (one-frame stack), most bytes first.  The
+	//	`.count` and `.bytes` are cumulative; there are no samples.
+	[[nodiscard]] std::vector<Site> collect_folded_sites() const;
+	static void _count_alloc  ( size_t size ) noexcept;
+	static void _count_dealloc( size_t size ) noexcept;
+
+	//Event stream.  While open, every `operator new` / `delete` also appends a compact binary record
+	//	(see `EventStream`) to the calling thread's ring file in `directory`, without locking or
+	//	symbolizing anything; the timeline is analyzed offline.  Set `.mode.record` false as well to
+	//	leave almost all tracing cost out of the process.  Each ring holds `ring_records` records,
+	//	after which the oldest are overwritten.  Can also be opened at startup, by setting the
+	//	`TINYLEAKCHECK_EVENT_STREAM` environment variable to the directory.  Returns whether it
+	//	succeeded (not supported on Windows).
+	static bool open_event_stream( char const* directory, std::size_t ring_records=1<<18 ) noexcept;
+	static void close_event_stream() noexcept;
+
+	//Background symbolization.  Starts a low-priority thread that, every `interval_ms`, symbolizes
+	//	and prettifies the stack frames of allocation sites whose blocks have stayed live since the
+	//	previous pass, caching them for the report at exit.  Stopped automatically before reporting.
+	static void start_background_symbolizer( std::uint32_t interval_ms=1000 ) noexcept;
+	static void stop_background_symbolizer() noexcept;
+
+	//Publishes all blocks still pending in per-thread logs to `.blocks`.  This is done
+	//	automatically before leaks are reported.
+	void flush() noexcept;
+
+	protected:
+		MemoryTracerBase();
+		~MemoryTracerBase() = default;
+};
+
+/*
+Policies.  A policy configures `BasicMemoryTracer` at compile time, so that features it leaves out
+cost nothing on the allocation path (not even a branch), and its hooks can be inlined there.  To
+make your own, derive from `DefaultPolicy` and override what you like, in a header named by
+`TINYLEAKCHECK_POLICY_HEADER`, and name it with `TINYLEAKCHECK_POLICY`.
+*/
+enum class StackCapture : std::uint8_t
+{
+	none,      //Never capture stack traces (`.mode.with_stacktrace` is ignored)
+	call_site, //Just the frame that called the allocation function, without unwinding
+	full       //Unwind the whole stack (up to `TINYLEAKCHECK_MAX_FRAMES` frames)
+};
+struct DefaultPolicy
+{
+	//Defaults of each thread's `.mode`, and how deeply it can be pushed
+	#ifndef TINYLEAKCHECK_NO_RECORD_ALLOCS_BY_DEFAULT
+		static constexpr bool record_by_default = true;
+	#else
+		static constexpr bool record_by_default = false;
+	#endif
+	#ifndef TINYLEAKCHECK_NO_STACK_TRACE_BY_DEFAULT
+		static constexpr bool stacktrace_by_default = true;
+	#else
+		static constexpr bool stacktrace_by_default = false;
+	#endif
+	static constexpr std::size_t pushable_depth = TINYLEAKCHECK_PUSHABLE_DEPTH;
+
+	static constexpr StackCapture stack_capture = StackCapture::full;
+
+	//Whether to keep the counters behind `.get_stats()` (otherwise, it returns only the overhead)
+	static constexpr bool statistics = true;
+
+	//Whether new records first go into a log of the allocating thread, so that short-lived blocks
+	//	never touch the shared registry, or straight into the registry.
+	static constexpr bool thread_logs = true;
+
+	//Whether to timestamp recorded blocks and keep the lifetime histograms behind
+	//	`.collect_churn()` (otherwise, it returns nothing)
+	static constexpr bool lifetimes = true;
+
+	//Hooks, called right after an allocation is recorded and right before a recorded block is
+	//	deallocated.  These forward to the tracer's `.callbacks`, so that they can be changed at
+	//	runtime; a policy that doesn't need that can do nothing (or its own thing) here instead.
+	template< class Tracer >
+	static void post_alloc( Tracer const& tracer, void* ptr, size_t alignment, size_t size )
+	{
+		tracer.callbacks.post_alloc( tracer, ptr, alignment, size );
+	}
+	template< class Tracer >
+	static void pre_dealloc( Tracer const& tracer, void* ptr, size_t alignment )
+	{
+		tracer.callbacks.pre_dealloc( tracer, ptr, alignment );
+	}
+};
+#ifdef TINYLEAKCHECK_POLICY_HEADER
+	#include TINYLEAKCHECK_POLICY_HEADER
+#endif
+
+//Memory tracer, with the given policy.  It is only instantiated (in "tinyleakcheck.cpp") for the
+//	configured policy; see `MemoryTracer`.
+template< class PolicyType >
+struct BasicMemoryTracer final : MemoryTracerBase
+{
+	using Policy = PolicyType;
+
+	//Recording mode.  Each thread has its own, starting from the defaults, so e.g. pushing `false`
+	//	onto `.record` only stops recording the calling thread's allocations (see also
+	//	`.set_override(⋯)`).  Deallocations of recorded blocks are always recorded, regardless.
+	struct Mode final
+	{
+		//Whether we are tracing memory
+		ArrayStack< bool, Policy::pushable_depth > record;
+		//Whether a stack trace should be recorded also.
+		ArrayStack< bool, Policy::pushable_depth > with_stacktrace;
+
+		constexpr Mode() noexcept :
+			record         ( Policy::record_by_default     ),
+			with_stacktrace( Policy::stacktrace_by_default )
+		{}
+	};
+	static thread_local Mode mode;
+
+	//Whether the calling thread's allocations are currently recorded (and with stack traces),
+	//	taking the override into account.  Lock-free.
+	[[nodiscard]] bool is_recording() const noexcept
+	{
+		auto record = static_cast<Override>( _override.load(std::memory_order_relaxed) & 0b11 );
+		if ( record == Override::none ) [[likely]] return mode.record.peek();
+		return record == Override::on;
+	}
+	[[nodiscard]] bool is_recording_stacktraces() const noexcept
+	{
+		if constexpr ( Policy::stack_capture == StackCapture::none ) return false;
+		auto with_stacktrace = static_cast<Override>( _override.load(std::memory_order_relaxed) >> 2 );
+		if ( with_stacktrace == Override::none ) [[likely]] return mode.with_stacktrace.peek();
+		return with_stacktrace == Override::on;
+	}
 
 	//Callbacks.  User may set to override defaults.
 	struct Callbacks
 	{
-		//Called by the default `.leaks_detected(⋯)`, for each block.  The default prettifies each
-		//	frame if there is a stack track, then calls `.basic_print()` on the block.
-		using PrintBlock = void(*)( MemoryTracer const& tracer, BlockInfo const& block );
-		PrintBlock print_block;
+		//Called by the default `.leaks_detected(⋯)`, for each site (i.e., all the leaked blocks
+		//	with the same allocation stack).  The default calls `.basic_print()` on the site, which
+		//	prettifies each frame if there is a stack trace.  (While this is left as the default,
+		//	sites are instead formatted in parallel and written out in large chunks.)
+		using PrintSite = void(*)( BasicMemoryTracer const& tracer, Site const& site );
+		PrintSite print_site;
 		
 		//Called immediately *after* each allocation.  Only enabled when recording is.  Default does
-		//	nothing.
+		//	nothing.  (Called by the policy's hook; see `DefaultPolicy`.)
 		using PostAlloc = void(*)(
-			MemoryTracer const& tracer, void* ptr, size_t alignment, size_t size
+			BasicMemoryTracer const& tracer, void* ptr, size_t alignment, size_t size
 		);
 		PostAlloc post_alloc;
 
 		//Called immediately *before* each deallocation.  Only enabled when recording is.  Default
-		//	does nothing.
+		//	does nothing.  (Likewise.)
 		using PreDealloc = void(*)(
-			MemoryTracer const& tracer, void* ptr, size_t alignment
+			BasicMemoryTracer const& tracer, void* ptr, size_t alignment
 		);
 		PreDealloc pre_dealloc;
 
 		//Called if leaks are detected on program close.  The default prints a message, calls
-		//	`.print_block(⋯)` on all blocks, and fails (trapping into debugger in debug mode) and
-		//	then `std::abort()`s).
-		using LeaksDetected = void(*)( MemoryTracer const& tracer );
+		//	`.print_site(⋯)` on each of `.collect_sites()`, and fails (trapping into debugger in debug mode) and
+		//	then `std::abort()`s), except when preloaded (see `TINYLEAKCHECK_PRELOAD`).
+		//
+		//Note that `.post_alloc(⋯)` and `.pre_dealloc(⋯)` are called concurrently from whichever
+		//	threads are allocating; they are not serialized by the tracer.
+		using LeaksDetected = void(*)( BasicMemoryTracer const& tracer );
 		LeaksDetected leaks_detected;
 	};
 	Callbacks callbacks;
 
-	MemoryTracer();
-	~MemoryTracer();
+	BasicMemoryTracer();
+	~BasicMemoryTracer();
 
 	//Record an allocation / deallocation.  User does not need, but should be able to call with
 	//	a custom memory allocator (e.g. to treat allocations within a pool as "real" allocations).
-	void record_alloc  ( void* ptr, size_t alignment, size_t size );
-	void record_dealloc( void* ptr, size_t alignment              );
+	//	The stack trace starts at the frame which returns to `call_site`; by default, that's the
+	//	caller of `.record_alloc(⋯)`, but an allocator can pass its own return address to leave
+	//	itself out of the trace.  If the deallocator knows the block's size (e.g. sized `operator
+	//	delete`), it can pass it to be checked against the recorded one.  Deallocation returns the
+	//	recorded size of the block, or `unknown_size` if it wasn't recorded.
+	void   record_alloc  ( void* ptr, size_t alignment, size_t size, void const* call_site=nullptr );
+	size_t record_dealloc( void* ptr, size_t alignment, size_t size=unknown_size                   );
+
+	//As above, but for allocators that keep a handle to the record next to the block (see
+	//	`TINYLEAKCHECK_INBAND_HEADER`).  `._record_alloc(⋯)` returns one more than the index of the
+	//	new record, or zero if the allocation was not recorded; `._record_dealloc(⋯)` takes that
+	//	value back, and retires the record without searching for it.
+	[[nodiscard]] std::uint32_t _record_alloc(
+		void* ptr, size_t alignment, size_t size, void const* call_site
+	);
+	void _record_dealloc( std::uint32_t slot, void* ptr );
+
+	//Record that a block was resized, and perhaps moved, as by `realloc(⋯)`.  Its record is updated
+	//	in place, keeping the original stack trace, rather than retired and recreated; if `old_ptr`
+	//	wasn't recorded, `new_ptr` is recorded as a new allocation.  Returns the old recorded size,
+	//	or `unknown_size`.  Since the old address can be reused as soon as the block has moved, an
+	//	allocator that can should instead call `._realloc_begin(⋯)` before moving it, and pass the
+	//	result to `._realloc_end(⋯)` afterward (with `new_ptr` null if that failed).
+	size_t record_realloc( void* old_ptr, void* new_ptr, size_t size, void const* call_site=nullptr );
+	[[nodiscard]] BlockInfo* _realloc_begin( void* old_ptr );
+	void _realloc_end( BlockInfo* block, void* new_ptr, size_t size, void const* call_site );
 };
+template< class PolicyType >
+thread_local typename BasicMemoryTracer<PolicyType>::Mode BasicMemoryTracer<PolicyType>::mode;
+
+//Memory tracer, as configured.  User does not need directly.
+using MemoryTracer = BasicMemoryTracer<TINYLEAKCHECK_POLICY>;
+extern template struct BasicMemoryTracer<TINYLEAKCHECK_POLICY>;
 
-//Per-thread memory tracer.  User does not need, but is exposed to the user.  Note may not exist
+//Global memory tracer.  User does not need, but is exposed to the user.  Note may not exist
 //	during static initialization!
 extern MemoryTracer* memory_tracer;
+
+//Allocator underneath the tracer, which the `operator new` / `delete` replacements forward to
+//	(see `TINYLEAKCHECK_BACKEND`).  It is selected once, on first use, and can't change afterward.
+//	Since the tracer only hooks in above it, the costs of tracing and of allocating can be measured
+//	separately.
+struct Backend final
+{
+	char const* name;
+	//Returns memory with at least the given alignment (a power of two), or `nullptr` on failure.
+	void* (*alloc)( size_t alignment, size_t size ) noexcept;
+	//Frees memory from `.alloc(⋯)`.  The alignment is the one it was allocated with, as is the
+	//	size, unless it is `MemoryTracer::unknown_size` (e.g. from unsized `operator delete`).
+	void (*dealloc)( void* ptr, size_t alignment, size_t size ) noexcept;
+};
+extern Backend const backend_malloc;
+extern Backend const backend_memalign;
+extern Backend const backend_sizeclass;
+[[nodiscard]] Backend const& backend() noexcept;
 #endif
 
 
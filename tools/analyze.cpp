@@ -0,0 +1,315 @@
+//Offline analyzer for TinyLeakCheck's binary event stream (see
+//	`TinyLeakCheck::MemoryTracer::open_event_stream(⋯)`).
+//
+//Usage:
+//	tinyleakcheck_analyze [--top ⟨N⟩] ⟨directory or file⟩...
+//
+//Reads every "*.events" ring (and "*.maps" address map) given, or found in a given directory,
+//	merges the threads' events by timestamp, and replays them to report totals, the peak of live
+//	memory, the top allocation sites, and the blocks never freed (leaks), grouped by stack.  Frames
+//	are printed as "⟨binary⟩+⟨offset⟩", ready for `addr2line -e ⟨binary⟩ ⟨offset⟩`.  If several
+//	processes wrote to the same directory, their blocks, sites, and address maps are kept apart
+//	(by pid); the totals are of all of them.
+//
+//This only needs the file formats from the header; it does not link the library itself.
+
+#include <tinyleakcheck/tinyleakcheck.hpp>
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using TinyLeakCheck::EventStream;
+
+
+
+struct Mapping final
+{
+	std::uint64_t begin;
+	std::uint64_t end;
+	std::uint64_t offset;
+	std::string path;
+};
+struct Event final
+{
+	EventStream::Record record;
+	std::uint32_t pid; //Of the process that wrote it
+};
+struct Site final
+{
+	std::uint32_t pid;
+	std::vector<std::uint64_t> frames;
+	std::uint64_t alloc_count = 0;
+	std::uint64_t alloc_bytes = 0;
+	std::uint64_t leak_count  = 0;
+	std::uint64_t leak_bytes  = 0;
+};
+struct LiveBlock final
+{
+	std::uint64_t size;
+	std::size_t site;
+};
+
+//Reads a ring file, appending its (surviving) records.  Returns false if the file is not a ring.
+static bool read_events( std::filesystem::path const& path, std::vector<Event>* events )
+{
+	std::ifstream file( path, std::ios::binary );
+	if ( !file ) return false;
+
+	EventStream::FileHeader header;
+	if ( !file.read( reinterpret_cast<char*>(&header), sizeof(header) ) ) return false;
+	if (
+		memcmp( header.magic, EventStream::magic, sizeof(header.magic) ) != 0 ||
+		header.version != EventStream::version || header.record_size != sizeof(EventStream::Record)
+	) {
+		fprintf( stderr, "Skipping \"%s\": not a (compatible) event stream.\n", path.string().c_str() );
+		return false;
+	}
+
+	std::uint64_t written = header.written.load(std::memory_order_relaxed);
+	std::uint64_t count = std::min( written, header.capacity );
+	if ( written > header.capacity )
+	{
+		fprintf( stderr,
+			"Warning: \"%s\" wrapped; its oldest %" PRIu64 " events were overwritten, so frees of "
+			"them are unmatched and peaks are underestimated.\n",
+			path.string().c_str(), written-header.capacity
+		);
+	}
+
+	std::vector<EventStream::Record> ring( header.capacity );
+	file.read( reinterpret_cast<char*>(ring.data()), std::streamsize(ring.size()*sizeof(EventStream::Record)) );
+	if ( static_cast<std::uint64_t>(file.gcount()) < header.capacity*sizeof(EventStream::Record) )
+	{
+		fprintf( stderr, "Warning: \"%s\" is truncated.\n", path.string().c_str() );
+		return false;
+	}
+
+	//Oldest first
+	for ( std::uint64_t k=written-count; k<written; ++k ) events->push_back({ ring[ k%header.capacity ], header.pid });
+	return true;
+}
+
+//Parses a copy of "/proc/⟨pid⟩/maps", named "tinyleakcheck.⟨pid⟩.maps", into that pid's mappings.
+static void read_maps(
+	std::filesystem::path const& path, std::unordered_map< std::uint32_t, std::vector<Mapping> >* mappings_by_pid
+) {
+	std::string stem = path.stem().string(); //"tinyleakcheck.⟨pid⟩"
+	std::size_t dot = stem.rfind('.');
+	char* end = nullptr;
+	unsigned long pid = strtoul( stem.c_str() + (dot==std::string::npos ? 0 : dot+1), &end, 10 );
+	if ( end==nullptr || *end!='\0' )
+	{
+		fprintf( stderr, "Skipping \"%s\": can't tell which process it is from its name.\n", path.string().c_str() );
+		return;
+	}
+	std::vector<Mapping>* mappings = &(*mappings_by_pid)[ static_cast<std::uint32_t>(pid) ];
+
+	std::ifstream file( path );
+	std::string line;
+	while ( std::getline(file,line) )
+	{
+		Mapping mapping;
+		char perms[ 8 ];
+		int path_start = 0;
+		if ( sscanf(
+			line.c_str(), "%" SCNx64 "-%" SCNx64 " %7s %" SCNx64 " %*s %*s %n",
+			&mapping.begin, &mapping.end, perms, &mapping.offset, &path_start
+		) < 4 ) continue;
+		if ( path_start==0 || line[static_cast<std::size_t>(path_start)]!='/' ) continue; //Anonymous
+		mapping.path = line.substr( static_cast<std::size_t>(path_start) );
+		mappings->push_back( std::move(mapping) );
+	}
+}
+
+static void print_frames( std::vector<std::uint64_t> const& frames, std::vector<Mapping> const& mappings )
+{
+	if ( frames.empty() ) printf("    (no stack trace recorded)\n");
+	for ( std::uint64_t frame : frames )
+	{
+		//(A return address points after the call; back up one so it lands inside it.)
+		std::uint64_t address = frame - 1;
+		auto iter = std::find_if( mappings.begin(),mappings.end(), [address]( Mapping const& mapping )
+		{
+			return address>=mapping.begin && address<mapping.end;
+		} );
+		if ( iter != mappings.end() )
+		{
+			printf( "    %s+0x%" PRIx64 "\n", iter->path.c_str(), address-iter->begin+iter->offset );
+		}
+		else
+		{
+			printf( "    0x%" PRIx64 "\n", frame );
+		}
+	}
+}
+
+static void print_bytes( std::uint64_t bytes )
+{
+	if      ( bytes >= 10u<<20 ) printf( "%" PRIu64 " MiB", bytes>>20 );
+	else if ( bytes >= 10u<<10 ) printf( "%" PRIu64 " KiB", bytes>>10 );
+	else                         printf( "%" PRIu64 " B"  , bytes     );
+}
+
+int main( int argc, char* argv[] )
+{
+	std::size_t top = 10;
+	std::vector<std::filesystem::path> events_paths;
+	std::vector<std::filesystem::path> maps_paths;
+	for ( int k=1; k<argc; ++k )
+	{
+		if ( strcmp(argv[k],"--top")==0 && k+1<argc )
+		{
+			top = static_cast<std::size_t>( strtoull( argv[++k], nullptr, 10 ) );
+			continue;
+		}
+
+		std::filesystem::path path = argv[k];
+		std::error_code error;
+		std::vector<std::filesystem::path> candidates;
+		if ( std::filesystem::is_directory(path,error) )
+		{
+			for ( auto const& entry : std::filesystem::directory_iterator(path,error) )
+			{
+				candidates.push_back( entry.path() );
+			}
+		}
+		else candidates.push_back(path);
+
+		for ( std::filesystem::path const& candidate : candidates )
+		{
+			if      ( candidate.extension() == ".events" ) events_paths.push_back(candidate);
+			else if ( candidate.extension() == ".maps"   ) maps_paths  .push_back(candidate);
+		}
+	}
+	if ( events_paths.empty() )
+	{
+		fprintf( stderr, "Usage: %s [--top N] <directory or file>...\n(No \".events\" files found.)\n", argv[0] );
+		return 1;
+	}
+	std::sort( events_paths.begin(), events_paths.end() );
+
+	std::vector<Event> events;
+	for ( std::filesystem::path const& path : events_paths ) read_events( path, &events );
+	std::unordered_map< std::uint32_t, std::vector<Mapping> > mappings;
+	for ( std::filesystem::path const& path : maps_paths ) read_maps( path, &mappings );
+	std::vector<Mapping> const no_mappings;
+	auto mappings_of = [&]( std::uint32_t pid ) -> std::vector<Mapping> const&
+	{
+		auto iter = mappings.find(pid);
+		return iter!=mappings.end() ? iter->second : no_mappings;
+	};
+
+	//Merge the threads' rings into one timeline (stably, so each thread's own order is kept on ties)
+	std::stable_sort( events.begin(),events.end(), []( Event const& a, Event const& b )
+	{
+		return a.record.timestamp < b.record.timestamp;
+	} );
+
+	//Replay.  Addresses only mean anything within their own process, so blocks and sites are per pid.
+	std::vector<Site> sites;
+	std::map< std::pair< std::uint32_t, std::vector<std::uint64_t> >, std::size_t > site_indices;
+	std::unordered_map< std::uint32_t, std::unordered_map< std::uint64_t, LiveBlock > > live_by_pid;
+	std::uint64_t alloc_count=0, alloc_bytes=0, free_count=0, free_bytes=0, unmatched_frees=0;
+	std::uint64_t live_count=0, live_bytes=0, peak_bytes=0, peak_time=0;
+	for ( auto const& [ event, pid ] : events )
+	{
+		std::unordered_map< std::uint64_t, LiveBlock >& live = live_by_pid[pid];
+		if ( event.op == EventStream::Op::alloc )
+		{
+			std::vector<std::uint64_t> frames( event.frames, event.frames+std::min<std::size_t>(event.frame_count,EventStream::max_frames) );
+			auto [ iter, inserted ] = site_indices.try_emplace( std::pair( pid, std::move(frames) ), sites.size() );
+			if ( inserted ) sites.push_back( Site{ .pid=pid, .frames=iter->first.second } );
+			Site& site = sites[ iter->second ];
+			++site.alloc_count;
+			site.alloc_bytes += event.size;
+
+			auto [ block, fresh ] = live.try_emplace( event.ptr, LiveBlock{ event.size, iter->second } );
+			if ( fresh ) ++live_count;
+			else
+			{
+				//Allocated again with no free seen in between (e.g. it was overwritten when the ring
+				//	wrapped), so the old block must be gone; it no longer counts as live.
+				live_bytes -= block->second.size;
+				block->second = LiveBlock{ event.size, iter->second };
+			}
+			++alloc_count;
+			alloc_bytes += event.size;
+			live_bytes  += event.size;
+			if ( live_bytes > peak_bytes ) { peak_bytes=live_bytes; peak_time=event.timestamp; }
+		}
+		else if ( event.op == EventStream::Op::dealloc )
+		{
+			auto iter = live.find( event.ptr );
+			if ( iter == live.end() ) { ++unmatched_frees; continue; }
+			++free_count;
+			free_bytes += iter->second.size;
+			live_bytes -= iter->second.size;
+			live.erase(iter);
+			--live_count;
+		}
+	}
+	for ( auto const& [ pid, live ] : live_by_pid )
+	for ( auto const& [ ptr, block ] : live )
+	{
+		++sites[ block.site ].leak_count;
+		sites[ block.site ].leak_bytes += block.size;
+	}
+
+	std::uint64_t first_time = events.empty() ? 0 : events.front().record.timestamp;
+	std::uint64_t last_time  = events.empty() ? 0 : events.back ().record.timestamp;
+	printf( "%zu ring file(s), %zu event(s) over %.3f s\n",
+		events_paths.size(), events.size(), double(last_time-first_time)*1e-9
+	);
+	printf( "  allocations: %" PRIu64 " (", alloc_count ); print_bytes(alloc_bytes); printf(")\n");
+	printf( "  frees:       %" PRIu64 " (", free_count  ); print_bytes(free_bytes ); printf(")\n");
+	if ( unmatched_frees > 0 ) printf( "  unmatched frees: %" PRIu64 "\n", unmatched_frees );
+	printf( "  peak live:   " ); print_bytes(peak_bytes);
+	printf( ", at %.3f s\n", double(peak_time-first_time)*1e-9 );
+
+	std::vector<std::size_t> order( sites.size() );
+	for ( std::size_t k=0; k<order.size(); ++k ) order[k]=k;
+
+	std::sort( order.begin(),order.end(), [&sites]( std::size_t a, std::size_t b )
+	{
+		return sites[a].alloc_bytes > sites[b].alloc_bytes;
+	} );
+	printf( "\nTop allocation sites, by bytes allocated:\n" );
+	for ( std::size_t k=0; k<std::min(top,order.size()); ++k )
+	{
+		Site const& site = sites[ order[k] ];
+		printf( "  %" PRIu64 " allocation(s), ", site.alloc_count );
+		print_bytes( site.alloc_bytes );
+		printf( ":\n" );
+		print_frames( site.frames, mappings_of(site.pid) );
+	}
+
+	std::sort( order.begin(),order.end(), [&sites]( std::size_t a, std::size_t b )
+	{
+		return sites[a].leak_bytes > sites[b].leak_bytes;
+	} );
+	if ( live_count == 0 )
+	{
+		printf( "\nNo leaks.\n" );
+		return 0;
+	}
+	printf( "\nLeaks: %" PRIu64 " block(s), ", live_count ); print_bytes(live_bytes); printf( "\n" );
+	for ( std::size_t index : order )
+	{
+		Site const& site = sites[index];
+		if ( site.leak_count == 0 ) break;
+		printf( "  %" PRIu64 " block(s), ", site.leak_count );
+		print_bytes( site.leak_bytes );
+		printf( ":\n" );
+		print_frames( site.frames, mappings_of(site.pid) );
+	}
+	return 2;
+}
@@ -0,0 +1,332 @@
+//Allocation benchmark: throughput and latency of `operator new` / `delete`, with and without the
+//	tracer.
+//
+//Usage:
+//	tinyleakcheck_bench [--threads ⟨max⟩] [--ops ⟨per thread⟩] [--out ⟨file⟩]
+//
+//Runs every workload (thread counts 1, 2, 4, ... up to the max; small, mixed, and large sizes;
+//	short- and long-lived blocks; frees on the allocating thread, or on the next thread over) in
+//	each tracer mode: "off" (`operator new` replaced, but nothing recorded), "record", and
+//	"record+stacks".  The "tinyleakcheck_bench_baseline" target is the same program built without
+//	the tracer at all, which runs the workloads once, in mode "baseline".
+//
+//Each run writes one line of JSON (to stdout, or appended to the `--out` file), so results can be
+//	collected and compared across versions; a readable summary goes to stderr.
+
+#ifndef TINYLEAKCHECK_BENCH_BASELINE
+	#include <tinyleakcheck/tinyleakcheck.hpp>
+#endif
+
+#include <algorithm>
+#include <barrier>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+
+enum class Sizes    { small, mixed, large };
+enum class Lifetime { short_lived, long_lived };
+enum class Frees    { same_thread, cross_thread };
+
+static char const* const sizes_names   [] = { "small", "mixed", "large" };
+static char const* const lifetime_names[] = { "short", "long" };
+static char const* const frees_names   [] = { "same-thread", "cross-thread" };
+
+struct Workload final
+{
+	unsigned threads;
+	Sizes sizes;
+	Lifetime lifetime;
+	Frees frees;
+};
+
+//Blocks each long-lived block outlives, on average (i.e. each thread keeps this many alive)
+static constexpr std::size_t long_lived_slots = 4096;
+//Blocks handed to the next thread at a time, for cross-thread frees
+static constexpr std::size_t handoff_batch = 256;
+//Every this-many operations is timed individually, for the latency percentiles
+static constexpr std::size_t latency_stride = 8;
+
+struct Mailbox final
+{
+	alignas(64) std::mutex mutex;
+	std::vector<void*> blocks;
+};
+
+struct ThreadState final
+{
+	std::uint64_t rng;
+	std::vector<void*> slots;
+	std::vector<void*> outbox;
+	std::vector<void*> inbox;
+	std::size_t frees;
+	std::vector<std::uint32_t> new_latencies;
+	std::vector<std::uint32_t> delete_latencies;
+	std::chrono::steady_clock::time_point begin, end;
+};
+
+[[nodiscard]] static std::uint64_t next_random( std::uint64_t* state ) noexcept
+{
+	//xorshift64*
+	*state ^= *state >> 12;
+	*state ^= *state << 25;
+	*state ^= *state >> 27;
+	return *state * 0x2545F4914F6CDD1Dull;
+}
+
+[[nodiscard]] static std::size_t next_size( Sizes sizes, std::uint64_t* rng ) noexcept
+{
+	std::uint64_t random = next_random(rng);
+	switch ( sizes )
+	{
+		case Sizes::small: return 8 + random%249;
+		case Sizes::mixed:
+		{
+			//Log-uniform over [8,64 KiB)
+			std::size_t exponent = 3 + (random>>32)%13;
+			return (std::size_t(1)<<exponent) + random%(std::size_t(1)<<exponent);
+		}
+		case Sizes::large: return 4096 + random%61441;
+	}
+	return 8;
+}
+
+[[nodiscard]] static std::uint32_t elapsed_ns(
+	std::chrono::steady_clock::time_point begin, std::chrono::steady_clock::time_point end
+) noexcept {
+	auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>( end - begin ).count();
+	return static_cast<std::uint32_t>( std::min<long long>( ns, UINT32_MAX ) );
+}
+
+//Frees a block that has become free-able (its own, or received from another thread): now, if short-
+//	lived, or else in place of a random long-lived one.
+static void retire( ThreadState* state, Lifetime lifetime, void* block )
+{
+	if ( lifetime == Lifetime::long_lived )
+	{
+		void*& slot = state->slots[ next_random(&state->rng) % long_lived_slots ];
+		std::swap( slot, block );
+		if ( block == nullptr ) return;
+	}
+
+	if ( state->frees++ % latency_stride == 0 )
+	{
+		auto begin = std::chrono::steady_clock::now();
+		::operator delete(block);
+		state->delete_latencies.push_back( elapsed_ns( begin, std::chrono::steady_clock::now() ) );
+	}
+	else ::operator delete(block);
+}
+
+static void run_thread(
+	Workload const& workload, std::size_t ops, unsigned index,
+	ThreadState* state, std::vector<Mailbox>* mailboxes, std::barrier<>* barrier
+) {
+	bool cross = workload.frees == Frees::cross_thread;
+	Mailbox& own  = (*mailboxes)[ index ];
+	Mailbox& next = (*mailboxes)[ (index+1) % workload.threads ];
+
+	barrier->arrive_and_wait(); //Start
+	state->begin = std::chrono::steady_clock::now();
+	for ( std::size_t op=0; op<ops; ++op )
+	{
+		std::size_t size = next_size( workload.sizes, &state->rng );
+
+		void* block;
+		if ( op%latency_stride == 0 )
+		{
+			auto begin = std::chrono::steady_clock::now();
+			block = ::operator new(size);
+			state->new_latencies.push_back( elapsed_ns( begin, std::chrono::steady_clock::now() ) );
+		}
+		else block=::operator new(size);
+		static_cast<volatile char*>(block)[0] = 1; //Touch it, as a real program would
+
+		if ( !cross )
+		{
+			retire( state, workload.lifetime, block );
+			continue;
+		}
+
+		state->outbox.push_back(block);
+		if ( state->outbox.size() == handoff_batch )
+		{
+			{
+				std::lock_guard lock_raii(next.mutex);
+				next.blocks.insert( next.blocks.end(), state->outbox.begin(),state->outbox.end() );
+			}
+			state->outbox.clear();
+
+			{
+				std::lock_guard lock_raii(own.mutex);
+				std::swap( state->inbox, own.blocks );
+			}
+			for ( void* received : state->inbox ) retire( state, workload.lifetime, received );
+			state->inbox.clear();
+		}
+	}
+	state->end = std::chrono::steady_clock::now();
+	barrier->arrive_and_wait(); //End of timed region
+
+	//Clean up (untimed)
+	if ( cross )
+	{
+		{
+			std::lock_guard lock_raii(next.mutex);
+			next.blocks.insert( next.blocks.end(), state->outbox.begin(),state->outbox.end() );
+		}
+		state->outbox.clear();
+		barrier->arrive_and_wait(); //All handed off
+		for ( void* received : own.blocks ) ::operator delete(received);
+		own.blocks.clear();
+	}
+	for ( void*& slot : state->slots )
+	{
+		::operator delete(slot);
+		slot = nullptr;
+	}
+}
+
+[[nodiscard]] static std::uint32_t percentile( std::vector<std::uint32_t>* samples, double fraction )
+{
+	if ( samples->empty() ) return 0;
+	auto nth = samples->begin() + static_cast<std::ptrdiff_t>( fraction*double(samples->size()-1) );
+	std::nth_element( samples->begin(), nth, samples->end() );
+	return *nth;
+}
+
+static void run_workload( Workload const& workload, char const* mode, std::size_t ops, FILE* out )
+{
+	//Everything is allocated up front, so that the timed region only allocates the blocks
+	std::vector<ThreadState> states( workload.threads );
+	std::vector<Mailbox> mailboxes( workload.threads );
+	for ( unsigned k=0; k<workload.threads; ++k )
+	{
+		ThreadState& state = states[k];
+		state.rng = 0x9E3779B97F4A7C15ull * (k+1);
+		state.frees = 0;
+		if ( workload.lifetime == Lifetime::long_lived ) state.slots.assign( long_lived_slots, nullptr );
+		state.outbox.reserve( handoff_batch );
+		state.inbox .reserve( 4*handoff_batch );
+		state.new_latencies   .reserve( ops/latency_stride + 1 );
+		state.delete_latencies.reserve( ops/latency_stride + 1 );
+		mailboxes[k].blocks.reserve( 4*handoff_batch );
+	}
+	std::barrier<> barrier( static_cast<std::ptrdiff_t>(workload.threads) );
+
+	std::vector<std::thread> threads;
+	threads.reserve( workload.threads );
+	for ( unsigned k=0; k<workload.threads; ++k )
+	{
+		threads.emplace_back( run_thread, std::cref(workload), ops, k, &states[k], &mailboxes, &barrier );
+	}
+	for ( std::thread& thread : threads ) thread.join();
+
+	//(The timed region is from the first thread starting to the last one finishing.)
+	auto begin = states[0].begin;
+	auto end   = states[0].end;
+	std::vector<std::uint32_t> new_latencies, delete_latencies;
+	for ( ThreadState const& state : states )
+	{
+		begin = std::min( begin, state.begin );
+		end   = std::max( end  , state.end   );
+		new_latencies   .insert( new_latencies   .end(), state.new_latencies   .begin(),state.new_latencies   .end() );
+		delete_latencies.insert( delete_latencies.end(), state.delete_latencies.begin(),state.delete_latencies.end() );
+	}
+
+	double seconds = std::chrono::duration<double>( end - begin ).count();
+	std::size_t total_ops = ops * workload.threads;
+	double ops_per_second = double(total_ops) / seconds;
+	std::uint32_t new_p50    = percentile( &new_latencies   , 0.50 );
+	std::uint32_t new_p99    = percentile( &new_latencies   , 0.99 );
+	std::uint32_t delete_p50 = percentile( &delete_latencies, 0.50 );
+	std::uint32_t delete_p99 = percentile( &delete_latencies, 0.99 );
+
+	fprintf( out,
+		"{\"mode\":\"%s\",\"threads\":%u,\"sizes\":\"%s\",\"lifetime\":\"%s\",\"frees\":\"%s\","
+		"\"ops\":%zu,\"seconds\":%.6f,\"ops_per_second\":%.0f,"
+		"\"new_p50_ns\":%u,\"new_p99_ns\":%u,\"delete_p50_ns\":%u,\"delete_p99_ns\":%u}\n",
+		mode, workload.threads, sizes_names[int(workload.sizes)], lifetime_names[int(workload.lifetime)],
+		frees_names[int(workload.frees)], total_ops, seconds, ops_per_second,
+		new_p50, new_p99, delete_p50, delete_p99
+	);
+	fflush(out);
+	fprintf( stderr,
+		"%-13s %2u thread(s) %-5s %-5s %-12s  %10.0f ops/s  new p50/p99 %5u/%6u ns  delete p50/p99 %5u/%6u ns\n",
+		mode, workload.threads, sizes_names[int(workload.sizes)], lifetime_names[int(workload.lifetime)],
+		frees_names[int(workload.frees)], ops_per_second, new_p50, new_p99, delete_p50, delete_p99
+	);
+}
+
+int main( int argc, char* argv[] )
+{
+	#ifndef TINYLEAKCHECK_BENCH_BASELINE
+		TinyLeakCheck::prevent_linker_elison();
+	#endif
+
+	unsigned max_threads = std::max( std::thread::hardware_concurrency(), 1u );
+	std::size_t ops = 100000;
+	FILE* out = stdout;
+	for ( int k=1; k<argc; ++k )
+	{
+		if      ( strcmp(argv[k],"--threads")==0 && k+1<argc ) max_threads = static_cast<unsigned>( atoi(argv[++k]) );
+		else if ( strcmp(argv[k],"--ops"    )==0 && k+1<argc ) ops = static_cast<std::size_t>( strtoull(argv[++k],nullptr,10) );
+		else if ( strcmp(argv[k],"--out"    )==0 && k+1<argc )
+		{
+			out = fopen( argv[++k], "a" );
+			if ( out == nullptr )
+			{
+				fprintf( stderr, "Could not open \"%s\".\n", argv[k] );
+				return 1;
+			}
+		}
+		else
+		{
+			fprintf( stderr, "Usage: %s [--threads <max>] [--ops <per thread>] [--out <file>]\n", argv[0] );
+			return 1;
+		}
+	}
+	max_threads = std::max( max_threads, 1u );
+
+	std::vector<unsigned> thread_counts;
+	for ( unsigned count=1; count<max_threads; count*=2 ) thread_counts.push_back(count);
+	thread_counts.push_back(max_threads);
+
+	for ( unsigned threads : thread_counts )
+	for ( Sizes sizes : { Sizes::small, Sizes::mixed, Sizes::large } )
+	for ( Lifetime lifetime : { Lifetime::short_lived, Lifetime::long_lived } )
+	for ( Frees frees : { Frees::same_thread, Frees::cross_thread } )
+	{
+		if ( frees==Frees::cross_thread && threads==1 ) continue;
+		Workload workload = { threads, sizes, lifetime, frees };
+
+		#ifdef TINYLEAKCHECK_BENCH_BASELINE
+			run_workload( workload, "baseline", ops, out );
+		#else
+			using Override = TinyLeakCheck::MemoryTracer::Override;
+			TinyLeakCheck::MemoryTracer* tracer = TinyLeakCheck::memory_tracer;
+
+			tracer->set_override( Override::off, Override::off );
+			run_workload( workload, "off", ops, out );
+
+			tracer->set_override( Override::on, Override::off );
+			run_workload( workload, "record", ops, out );
+
+			tracer->set_override( Override::on, Override::on );
+			run_workload( workload, "record+stacks", ops, out );
+
+			tracer->set_override( Override::none, Override::none );
+		#endif
+	}
+
+	if ( out != stdout ) fclose(out);
+	return 0;
+}